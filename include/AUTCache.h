@@ -0,0 +1,51 @@
+#ifndef AUT_CACHE_H
+#define AUT_CACHE_H
+
+#include "EventSource.h"
+#include "Table.h"
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Table AUT at the true and reco kinematics of each input entry. Values are looked up on first
+// use and reused by later injections and jobs; the cache can be persisted next to the other
+// per-input caches and is only reloaded for the same input size and table contents.
+class AUTCache {
+public:
+    struct Value {
+        double trueAUT;
+        double recoAUT;
+    };
+
+    explicit AUTCache(const Table* table);
+
+    // Thread-safe: concurrent injection workers prepare their bins against one cache
+    Value get(Long64_t entry, const Event& ev) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = values.find(entry);
+        if (it != values.end())
+            return it->second;
+        return insert(entry, ev);
+    }
+    size_t size() const {
+        return values.size();
+    }
+    // True if entries were added since the last load/save
+    bool isDirty() const {
+        return dirty;
+    }
+
+    bool save(const std::string& cacheFile, Long64_t nEntries);
+    // Returns false if the file is missing or was written for another input/table
+    bool load(const std::string& cacheFile, Long64_t nEntries);
+
+private:
+    const Value& insert(Long64_t entry, const Event& ev);
+    const Table* table;
+    unsigned long long tableHash;
+    std::unordered_map<Long64_t, Value> values;
+    bool dirty = false;
+    std::mutex mutex;
+};
+
+#endif // AUT_CACHE_H
@@ -1,6 +1,7 @@
 #ifndef ARG_PARSER_H
 #define ARG_PARSER_H
 
+#include "EventRange.h"
 #include <string>
 #include <cstdint>
 #include <optional>
@@ -11,19 +12,48 @@ struct Args {
     std::string energyConfig;
     std::string table;
     bool overwrite = false;
+    bool resume = false; // reuse the journaled jobs of an earlier inject run
+    bool useBinIndex = false;
     std::string outDir = "out";
     std::string outFilename = "";
+    std::string toys; // inject summary YAML to cross-check projections against
     long long maxEntries = -1;
+    // Event range (see EventRange)
+    long long firstEntry = 0;
+    long long lastEntry = -1;
+    long long stride = 1;
+    double fraction = 1.0;
+    unsigned long long fractionSeed = 0;
+    std::string entryList;
+    int nThreads = 1;
     double targetPolarization = 1.0;
     int n_injections = 10;
+    unsigned long long seed = 0;
     std::vector<std::string> grid;
     int bin_index = 0;
     int bin_index_start = 0;
     int bin_index_end = -1;
+    bool all_bins = false; // --bins all
     bool extract_with_true = false;
+    bool extract_both = false; // --extract_with_true both
     std::optional<double> A_opt;
+    std::vector<double> A_scan;
+    std::vector<double> polarization_scan;
+    bool common_random_numbers = false;
+    double target_precision = 0.0;
+    int min_injections = 5;
+    int max_injections = 0;
+    bool asimov = false;
+    int binned = 0;
+    std::vector<std::string> modulations; // --modulations collins,sivers,pretzelosity
+    std::vector<double> A_modulations;
+    bool bootstrap = false;
+    double aggregate = 0.0;
+    int fast_toys = 0;
 };
 
 Args parseArgs(int argc, char** argv);
+// Event range described by --firstEntry/--lastEntry/--maxEntries/--stride/--fraction/--entryList
+EventRange makeEventRange(const Args& args);
 
 #endif // ARG_PARSER_H
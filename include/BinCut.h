@@ -0,0 +1,17 @@
+#ifndef BIN_CUT_H
+#define BIN_CUT_H
+
+#include "EventSource.h"
+#include "TCut.h"
+
+// Bin selection evaluated natively on each event; the TCut is kept for cache titles
+struct BinCut {
+    TCut cut;
+    double xMin, xMax;
+    double q2Min, q2Max;
+    bool pass(const Event& ev) const {
+        return ev.X >= xMin && ev.X < xMax && ev.Q2 >= q2Min && ev.Q2 < q2Max;
+    }
+};
+
+#endif // BIN_CUT_H
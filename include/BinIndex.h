@@ -0,0 +1,50 @@
+#ifndef BIN_INDEX_H
+#define BIN_INDEX_H
+
+#include "Bin.h"
+#include "EntryBitmap.h"
+#include "EventRange.h"
+#include "EventSource.h"
+#include "Table.h"
+#include <string>
+#include <vector>
+
+// Per-table-row selection index: for every (X,Q,Z,PhPerp) row of the table we keep a
+// compressed bitmap of the tree entries passing the reco and the true selection.
+// Coarser grid bins (X, X.Q, ...) are served by OR-ing the rows they contain.
+class BinIndex {
+public:
+    BinIndex() = default;
+
+    // Single pass over the entries of the range (same inclusive cuts as Inject); multi-file inputs are indexed
+    // one file per thread
+    void build(EventSource& source, const Table& table, const EventRange& range = EventRange(), int nThreads = 1);
+    bool save(const std::string& cacheFile) const;
+    // Returns false if the cache is missing or was built for another tree/table
+    bool load(const std::string& cacheFile, const Table& table, Long64_t nEntries);
+
+    // Entries selected in a grid bin (OR over the table rows contained in it)
+    EntryBitmap select(const Bin& bin, bool useTrue) const;
+    // Whether the rows contained in the bin cover its bounds, so that select() holds every entry the bin's inclusive
+    // cut accepts. A grid bin is the envelope of its rows; where they leave gaps the bin must be scanned instead.
+    bool covers(const Bin& bin) const;
+
+    const EntryBitmap& rowBitmap(size_t row, bool useTrue) const {
+        return useTrue ? truth.at(row) : reco.at(row);
+    }
+    size_t size() const {
+        return rows.size();
+    }
+    Long64_t getEntries() const {
+        return nEntries;
+    }
+
+private:
+    static unsigned long long boundsHash(const std::vector<TableRow>& rows);
+    std::vector<TableRow> rows;
+    std::vector<EntryBitmap> reco;
+    std::vector<EntryBitmap> truth;
+    Long64_t nEntries{0};
+};
+
+#endif // BIN_INDEX_H
@@ -0,0 +1,62 @@
+#ifndef COUNTER_RNG_H
+#define COUNTER_RNG_H
+
+#include <array>
+#include <cstdint>
+
+// Counter-based generator (Philox4x32-10, Salmon et al., SC'11). The output is a pure function
+// of (key, counter): draws depend only on what they are keyed by, not on call order, threading
+// or chunking, and any number of them can be generated independently (e.g. in SIMD batches).
+class Philox4x32 {
+public:
+    using Counter = std::array<uint32_t, 4>;
+    using Key = std::array<uint32_t, 2>;
+
+    static Counter generate(Counter ctr, Key key) {
+        for (int r = 0; r < 10; ++r) {
+            if (r > 0) {
+                key[0] += kW0;
+                key[1] += kW1;
+            }
+            const uint64_t p0 = static_cast<uint64_t>(kM0) * ctr[0];
+            const uint64_t p1 = static_cast<uint64_t>(kM1) * ctr[2];
+            ctr = {static_cast<uint32_t>(p1 >> 32) ^ ctr[1] ^ key[0], static_cast<uint32_t>(p1),
+                   static_cast<uint32_t>(p0 >> 32) ^ ctr[3] ^ key[1], static_cast<uint32_t>(p0)};
+        }
+        return ctr;
+    }
+
+    // Uniform in (0, 1) from 32 or 64 random bits
+    static double uniform(uint32_t bits) {
+        return (static_cast<double>(bits) + 0.5) * 0x1p-32;
+    }
+    static double uniform(uint32_t hi, uint32_t lo) {
+        return (static_cast<double>(((static_cast<uint64_t>(hi) << 32) | lo) >> 11) + 0.5) * 0x1p-53;
+    }
+
+private:
+    static constexpr uint32_t kM0 = 0xD2511F53;
+    static constexpr uint32_t kM1 = 0xCD9E8D57;
+    static constexpr uint32_t kW0 = 0x9E3779B9;
+    static constexpr uint32_t kW1 = 0xBB67AE85;
+};
+
+// Random stream of one injection toy: one Philox block per event, keyed by the user seed and
+// counted by (event, bin, injection, stream). The stream index shares the high word of the
+// entry number, so entries must stay below 2^48.
+struct SpinStream {
+    uint64_t seed = 0;
+    uint32_t bin = 0;
+    uint32_t injection = 0;
+    uint32_t stream = 0;
+
+    // Three uniforms for an input entry: u[0] (53-bit), u[1] and u[2] (32-bit)
+    std::array<double, 3> draw(uint64_t entry) const {
+        const Philox4x32::Counter c = Philox4x32::generate(
+            {static_cast<uint32_t>(entry), static_cast<uint32_t>(entry >> 32) ^ (stream << 16), bin, injection},
+            {static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)});
+        return {Philox4x32::uniform(c[0], c[1]), Philox4x32::uniform(c[2]), Philox4x32::uniform(c[3])};
+    }
+};
+
+#endif // COUNTER_RNG_H
@@ -0,0 +1,102 @@
+#ifndef ENTRY_BITMAP_H
+#define ENTRY_BITMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Compressed set of tree entry numbers (roaring-style).
+// Entries are split into 2^16-wide chunks keyed by their high bits. Sparse chunks
+// are stored as sorted arrays of the low 16 bits, dense chunks as 1024-word bitsets.
+class EntryBitmap {
+public:
+    EntryBitmap() = default;
+
+    // Entries are cheapest to add in increasing order (as produced by a tree loop)
+    void add(uint64_t entry);
+    bool contains(uint64_t entry) const;
+    uint64_t cardinality() const;
+    bool empty() const {
+        return containers.empty();
+    }
+    void clear() {
+        containers.clear();
+    }
+
+    // Union in place (used to serve coarse grid bins from fine table rows)
+    EntryBitmap& operator|=(const EntryBitmap& other);
+    static EntryBitmap unite(const std::vector<const EntryBitmap*>& bitmaps);
+
+    // Visit every entry in increasing order
+    template <typename F>
+    void forEach(F&& f) const {
+        for (const auto& c : containers)
+            visit(c, f);
+    }
+
+    // Visit the entries in [begin, end) in increasing order, skipping chunks outside the range
+    template <typename F>
+    void forEachInRange(uint64_t begin, uint64_t end, F&& f) const {
+        for (const auto& c : containers) {
+            const uint64_t base = c.key << 16;
+            if (base + 0x10000 <= begin)
+                continue;
+            if (base >= end)
+                break;
+            if (base >= begin && base + 0x10000 <= end) {
+                visit(c, f);
+                continue;
+            }
+            visit(c, [&](uint64_t e) {
+                if (e >= begin && e < end)
+                    f(e);
+            });
+        }
+    }
+
+    // Flat byte encoding for persistence (see BinIndex)
+    std::vector<unsigned char> serialize() const;
+    static EntryBitmap deserialize(const std::vector<unsigned char>& bytes);
+
+private:
+    static constexpr uint32_t kArrayMax = 4096; // above this a bitset is smaller
+    static constexpr size_t kBitsetWords = 1024;
+
+    struct Container {
+        uint64_t key = 0;
+        uint32_t card = 0;
+        std::vector<uint16_t> array; // sorted low bits (sparse)
+        std::vector<uint64_t> bits;  // kBitsetWords words (dense)
+
+        bool isBitset() const {
+            return !bits.empty();
+        }
+        void add(uint16_t low);
+        bool contains(uint16_t low) const;
+        void toBitset();
+        void unite(const Container& other);
+    };
+
+    // Visit the entries of one container in increasing order
+    template <typename F>
+    static void visit(const Container& c, F&& f) {
+        const uint64_t base = c.key << 16;
+        if (c.isBitset()) {
+            for (size_t w = 0; w < c.bits.size(); ++w) {
+                uint64_t word = c.bits[w];
+                while (word) {
+                    const int bit = __builtin_ctzll(word);
+                    f(base + (w << 6) + static_cast<uint64_t>(bit));
+                    word &= word - 1;
+                }
+            }
+        } else {
+            for (uint16_t low : c.array)
+                f(base + low);
+        }
+    }
+    Container& containerFor(uint64_t key);
+    std::vector<Container> containers; // sorted by key
+};
+
+#endif // ENTRY_BITMAP_H
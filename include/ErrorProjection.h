@@ -0,0 +1,87 @@
+#ifndef ERROR_PROJECTION_H
+#define ERROR_PROJECTION_H
+
+#include "EventRange.h"
+#include "EventSource.h"
+#include "FastToys.h"
+#include "Grid.h"
+#include <string>
+#include <vector>
+
+// Analytic projection of the statistical error on A for every bin of a grid, from one pass over the input.
+// For the fitted model 1 + P A g s, with g = S_T Depol sin(PhiH + PhiS) and s = +-1 drawn with probability
+// (1 + s P A g)/2, the expected Fisher information of a bin is
+//   I(A) = sum_events W (P g)^2 / (1 - (P A g)^2),   W = Weight * scale
+// and sigma(A) = 1/sqrt(I), the error the toy fits converge to when rescaled to the expected yield.
+class ErrorProjection {
+public:
+    struct BinSums {
+        Long64_t events = 0;     // MC events in the bin
+        double sumW = 0.0;       // sum of MC weights
+        double sumW2 = 0.0;      // sum of squared MC weights
+        double expected = 0.0;   // expected events (sum of Weight * scale)
+        double fisher = 0.0;     // I(A)
+        double sumWg2 = 0.0;     // sum of W g^2 (without polarization), for the mean analyzing power
+        double sigma() const;
+        double nEffMC() const;
+    };
+
+    ErrorProjection(EventSource* source, const Grid* grid, double scale, double targetPolarization);
+    // Amplitude at which the information is evaluated (default 0)
+    void setAmplitude(double A) { amplitude = A; }
+    void setEventRange(const EventRange& r) { range = r; }
+    // Worker threads for multi-file inputs (one file per task)
+    void setThreads(int n) { nThreads = n; }
+    // Fast toys: the pass also fills a (PhiH + PhiS, S_T Depol) density per bin, and nToys spin toys of every bin are
+    // sampled from it (see runFastToys). With a cache file the densities are reused when the input, range, grid and
+    // cells match, and the event pass is skipped.
+    void setFastToys(int nToys, int phiCells = 36, int analyzingCells = 20) {
+        fastToys = nToys;
+        densityPhiCells = phiCells;
+        densityAnalyzingCells = analyzingCells;
+    }
+    void setDensityCache(const std::string& path) { densityCacheFile = path; }
+    // Files the source reads, in order; part of the density cache key
+    void setInputFiles(const std::vector<std::string>& files) { inputFiles = files; }
+    void setSeed(uint64_t s) { seed = s; }
+
+    // Single pass over the entries of the range, filling the reco- and true-binned sums of every bin
+    void run();
+    const std::vector<BinSums>& getReco() const { return reco; }
+    const std::vector<BinSums>& getTrue() const { return truth; }
+    const std::vector<FastToyResult>& getRecoFastToys() const { return recoFast; }
+    const std::vector<FastToyResult>& getTrueFastToys() const { return trueFast; }
+
+    // Writes the projections to YAML; with toyYaml (an inject summary) the mean toy errors of the same bins
+    // are written next to them, with their ratio to the projection
+    bool writeYaml(const std::string& path, const std::string& toyYaml = "") const;
+
+private:
+    void fillFromEvents();
+    void fillFromDensities();
+    bool saveDensities(const std::string& path) const;
+    bool loadDensities(const std::string& path);
+    // Identifies the input files, tree, entries, range, grid and cells a density cache was built for
+    unsigned long long densityKey() const;
+
+    EventSource* source;
+    const Grid* grid;
+    double scale;
+    double targetPolarization;
+    double amplitude = 0.0;
+    EventRange range;
+    int nThreads = 1;
+    std::vector<BinSums> reco;
+    std::vector<BinSums> truth;
+    int fastToys = 0;
+    int densityPhiCells = 36;
+    int densityAnalyzingCells = 20;
+    std::string densityCacheFile;
+    std::vector<std::string> inputFiles;
+    uint64_t seed = 0;
+    bool densityFromCache = false;
+    std::vector<ToyDensity> recoDensity, trueDensity;
+    std::vector<FastToyResult> recoFast, trueFast;
+};
+
+#endif // ERROR_PROJECTION_H
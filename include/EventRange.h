@@ -0,0 +1,78 @@
+#ifndef EVENT_RANGE_H
+#define EVENT_RANGE_H
+
+#include "Rtypes.h"
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Subset of input entries processed by every event loop (Hist, Inject, BinIndex).
+// The criteria combine: an entry is processed if it lies in [first, last), sits on the stride
+// grid starting at first, passes the hash-based fraction and (when given) is in the explicit list.
+// Setup is O(1) (the list is shared between copies), and loops visit only the selected entries.
+class EventRange {
+public:
+    EventRange() = default;
+    static EventRange firstN(Long64_t n);
+
+    EventRange& setFirst(Long64_t first);
+    // Exclusive end; negative means up to the end of the input
+    EventRange& setLast(Long64_t last);
+    EventRange& setStride(Long64_t stride);
+    // Deterministic subsample: entry e is kept if hash(e, seed) falls below fraction of the hash range
+    EventRange& setFraction(double fraction, uint64_t seed = 0);
+    EventRange& setEntries(std::vector<Long64_t> entries);
+
+    bool isFull() const;
+    bool contains(Long64_t entry) const;
+    // Number of entries processed out of an input of nEntries (expected value when a fraction is set)
+    double count(Long64_t nEntries) const;
+    // count / nEntries, used to rescale the luminosity weight
+    double acceptance(Long64_t nEntries) const;
+    // Short file-name-safe tag for cache names ("" when processing everything)
+    std::string tag() const;
+
+    // Visit the selected entries in [begin, end) in increasing order
+    template <typename F>
+    void forEach(Long64_t begin, Long64_t end, F&& f) const {
+        const Long64_t lo = std::max(begin, first);
+        const Long64_t hi = last < 0 ? end : std::min(end, last);
+        if (lo >= hi)
+            return;
+        if (entries) {
+            for (auto it = std::lower_bound(entries->begin(), entries->end(), lo); it != entries->end() && *it < hi; ++it) {
+                if ((*it - first) % stride == 0 && passHash(*it))
+                    f(*it);
+            }
+            return;
+        }
+        for (Long64_t e = first + (lo - first + stride - 1) / stride * stride; e < hi; e += stride) {
+            if (passHash(e))
+                f(e);
+        }
+    }
+
+private:
+    bool passHash(Long64_t entry) const {
+        if (threshold == ~0ULL)
+            return true;
+        // splitmix64 finalizer
+        uint64_t z = static_cast<uint64_t>(entry) + seed * 0x9E3779B97F4A7C15ULL + 0x9E3779B97F4A7C15ULL;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        z ^= z >> 31;
+        return z < threshold;
+    }
+
+    Long64_t first{0};
+    Long64_t last{-1};
+    Long64_t stride{1};
+    double fraction{1.0};
+    uint64_t seed{0};
+    uint64_t threshold{~0ULL}; // ~0 keeps every entry
+    std::shared_ptr<const std::vector<Long64_t>> entries;
+};
+
+#endif // EVENT_RANGE_H
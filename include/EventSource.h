@@ -0,0 +1,114 @@
+#ifndef EVENT_SOURCE_H
+#define EVENT_SOURCE_H
+
+#include "Rtypes.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+class TChain;
+class TTree;
+
+// Columns read by the histogramming and injection engines (branch names of SidisTree)
+struct Event {
+    double X{0}, Q2{0}, Z{0}, PhPerp{0}, PhiH{0}, PhiS{0}, Y{0};
+    double TrueX{0}, TrueQ2{0}, TrueZ{0}, TruePhPerp{0}, TruePhiH{0}, TruePhiS{0}, TrueY{0};
+    double Weight{1.0};
+
+    // Member pointer for a column name, nullptr if unknown
+    static double Event::*column(const std::string& name);
+    static const std::vector<std::string>& columnNames();
+};
+
+// Common column-reader interface over TTree and RNTuple inputs
+class EventSource {
+public:
+    virtual ~EventSource() = default;
+    virtual Long64_t getEntries() const = 0;
+    // Reads every available column of an entry; the reference stays valid until the next call
+    virtual const Event& getEntry(Long64_t entry) = 0;
+    virtual bool hasColumn(const std::string& name) const = 0;
+    virtual std::string getName() const = 0;
+    // Underlying TTree (nullptr for non-TTree inputs)
+    virtual TTree* getTree() const {
+        return nullptr;
+    }
+
+    // Independently readable parts (one per input file) for parallel passes.
+    // Part p covers the global entries [getPartOffset(p), getPartOffset(p) + getPartEntries(p)).
+    virtual size_t getNumParts() const {
+        return 1;
+    }
+    virtual Long64_t getPartOffset(size_t) const {
+        return 0;
+    }
+    virtual Long64_t getPartEntries(size_t) const {
+        return getEntries();
+    }
+    // Private reader over one part, indexed by local entry (nullptr if the input cannot be reopened)
+    virtual std::unique_ptr<EventSource> openPart(size_t) const {
+        return nullptr;
+    }
+    // Private reader over the whole input, indexed like this one, for concurrent workers (nullptr if the input
+    // cannot be reopened)
+    virtual std::unique_ptr<EventSource> reopen() const {
+        return nullptr;
+    }
+};
+
+class TreeEventSource : public EventSource {
+public:
+    // Reads a tree owned by the caller
+    explicit TreeEventSource(TTree* tree);
+    // Chains the tree over every file; returns nullptr if the first file has no TTree of that name
+    static std::unique_ptr<TreeEventSource> open(const std::vector<std::string>& files, const std::string& treename);
+    ~TreeEventSource() override;
+    Long64_t getEntries() const override;
+    const Event& getEntry(Long64_t entry) override;
+    bool hasColumn(const std::string& name) const override;
+    std::string getName() const override;
+    TTree* getTree() const override {
+        return tree;
+    }
+    size_t getNumParts() const override;
+    Long64_t getPartOffset(size_t part) const override;
+    Long64_t getPartEntries(size_t part) const override;
+    std::unique_ptr<EventSource> openPart(size_t part) const override;
+    std::unique_ptr<EventSource> reopen() const override;
+
+private:
+    void bindColumns();
+    TTree* tree;
+    std::unique_ptr<TChain> chain; // set when built by open()
+    std::vector<std::string> files;
+    std::vector<Long64_t> offsets; // first global entry of each file, plus the total
+    Event buffer;
+    std::vector<std::string> present;
+};
+
+// Reads an RNTuple with the same field names as the TTree branches
+class RNTupleEventSource : public EventSource {
+public:
+    // Files are read back to back; returns nullptr if any file holds no RNTuple of that name
+    static std::unique_ptr<RNTupleEventSource> open(const std::vector<std::string>& files, const std::string& ntupleName);
+    ~RNTupleEventSource() override;
+    Long64_t getEntries() const override;
+    const Event& getEntry(Long64_t entry) override;
+    bool hasColumn(const std::string& name) const override;
+    std::string getName() const override;
+    size_t getNumParts() const override;
+    Long64_t getPartOffset(size_t part) const override;
+    Long64_t getPartEntries(size_t part) const override;
+    std::unique_ptr<EventSource> openPart(size_t part) const override;
+    std::unique_ptr<EventSource> reopen() const override;
+
+private:
+    RNTupleEventSource() = default;
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+    Event buffer;
+    std::string name;
+    std::vector<std::string> files;
+};
+
+#endif // EVENT_SOURCE_H
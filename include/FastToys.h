@@ -0,0 +1,46 @@
+#ifndef FAST_TOYS_H
+#define FAST_TOYS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Density of the events of one bin in cells of (PhiH + PhiS, S_T Depol): everything a spin toy of the
+// single-amplitude fit depends on. Filled in one pass (see ErrorProjection) and independent of the table,
+// the amplitude, the polarization and the luminosity scale, so it can be cached and reused.
+struct ToyDensity {
+    struct Cell {
+        long long events = 0; // MC events
+        double sumW = 0.0;    // sum of MC weights
+        double sumW2 = 0.0;   // sum of squared MC weights
+        double sumG = 0.0;    // sum of g = S_T Depol sin(PhiH + PhiS)
+        double sumWG2 = 0.0;  // sum of w g^2
+    };
+    int nPhi = 0;
+    int nAnalyzing = 0;
+    std::vector<Cell> cells; // nPhi x nAnalyzing, phi-major
+
+    void reset(int phiCells, int analyzingCells);
+    // phi = PhiH + PhiS (any range), analyzing = S_T Depol in [0, 1]
+    void fill(double phi, double analyzing, double w);
+    void merge(const ToyDensity& other);
+};
+
+// Binned likelihood of the spins given per-cell analyzing powers c_j: sum_j U_j log(1 + c_j A) + D_j log(1 - c_j A),
+// maximized by Newton iterations. Returns false if the likelihood has no curvature (e.g. no events).
+bool fitCellAmplitude(const double* up, const double* down, const double* c, size_t nCells, double& A, double& error);
+
+// Fast toys of one bin from its density: each toy redraws the spins of the MC events of every cell,
+// U_j ~ Binomial(n_j, (1 + P A g_j)/2), and fits the cells. This mirrors a full injection (same MC events,
+// new spins), with the errors scaled to the expected yield by sqrt(n_eff_mc/expected) in the same way.
+struct FastToyResult {
+    int n = 0;
+    double meanExtracted = 0.0;
+    double stddevExtracted = 0.0;
+    double meanError = 0.0;
+};
+// The toys of a (seed, stream) pair are reproducible; use one stream per bin and dataset.
+FastToyResult runFastToys(const ToyDensity& density, double A, double polarization, double scale, int nToys, uint64_t seed,
+                          uint32_t stream);
+
+#endif // FAST_TOYS_H
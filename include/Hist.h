@@ -1,8 +1,10 @@
 #ifndef HIST_H
 #define HIST_H
+#include "BinCut.h"
+#include "EventRange.h"
+#include "EventSource.h"
 #include "TCut.h"
 #include "TH1.h" // switch to base class
-#include "TTree.h"
 #include <map>
 #include <string>
 #include <unordered_map>
@@ -17,8 +19,16 @@ struct HistParams {
 
 class Hist {
 public:
-    Hist(TTree* tree);
-    void fillHistograms(const std::string& var, const std::map<std::string, TCut>& binTCuts, double scale = 1.0);
+    Hist(EventSource* source);
+    void fillHistograms(const std::string& var, const std::map<std::string, BinCut>& binCuts, double scale = 1.0);
+    // Threads used to fill multi-file inputs (one file per task)
+    void setThreads(int n) {
+        nThreads = n;
+    }
+    // Entries visited by fillHistograms (default: all)
+    void setEventRange(const EventRange& r) {
+        range = r;
+    }
     HistParams getDefaultParams() const {
         return defaultParams;
     }
@@ -42,8 +52,10 @@ public:
     }
 
 private:
-    TTree* tree;
+    EventSource* source;
     bool m_hasWeightBranch;
+    int nThreads{1};
+    EventRange range;
     static const std::map<std::string, HistParams> varParams;
     static const HistParams defaultParams;
     HistParams getParams(const std::string& var, int nbins, double xmin, double xmax) const;
@@ -1,27 +1,145 @@
 #ifndef INJECT_H
 #define INJECT_H
 
+#include "AUTCache.h"
 #include "Bin.h"
+#include "EntryBitmap.h"
+#include "EventRange.h"
+#include "EventSource.h"
 #include "Grid.h"
+#include "Kinematics.h"
+#include "Modulation.h"
 #include "TCut.h"
-#include "TTree.h"
 #include "Table.h"
 #include <memory>
 #include <string>
 #include <vector>
 #include <optional>
 
+// Events of one bin selected from the input once, with their spin-transfer quantities and table
+// asymmetries; reused by every injection and scan point of a job
+struct PreparedBin {
+    const Bin* bin = nullptr;
+    bool fitsReco = false; // reco-binned dataset (fit with reco kinematics)
+    bool fitsTrue = false; // true-binned dataset (fit with true kinematics)
+    std::vector<Event> events;
+    std::vector<Long64_t> entries;
+    std::vector<unsigned char> inReco, inTrue; // dataset membership of each event
+    KinematicsBatch truth, reco;               // reco only when fitsReco
+    std::vector<double> trueAUT, recoAUT;      // table asymmetries (empty unless prepared for the table)
+    // Binned fit (nCells > 0): analyzing-power cell of each event and mean analyzing power of each cell
+    int nCells = 0;
+    std::vector<int> recoCell, trueCell;
+    std::vector<double> recoCellG, trueCellG;
+    // Multi-modulation extraction (non-empty modulations): basis S_T D_m f_m of every event (event-major, without
+    // the polarization) and its unit-weight moments over each dataset
+    std::vector<Modulation> modulations;
+    std::vector<double> recoBasis, trueBasis;
+    ModulationMoments recoMoments, trueMoments;
+    size_t size() const { return events.size(); }
+};
+
 class Inject {
 public:
-    Inject(TTree* tree, const Table* table, double scale = 1.0, double targetPolarization = 1.0);
+    // One injected configuration: amplitude (nullopt: the table) and target polarization
+    struct Point {
+        std::optional<double> A;
+        double polarization = 1.0;
+        // Injected amplitude of each prepared modulation (nullopt: the table); empty for a single-modulation bin
+        std::vector<std::optional<double>> modulationA;
+        bool usesTable() const;
+    };
+    // Reco-binned and true-binned extractions of the same toy (only the fitted ones are set)
+    struct DualResult {
+        std::pair<double, double> reco{0.0, 0.0};
+        std::pair<double, double> truth{0.0, 0.0};
+        int recoEvents = 0;
+        int trueEvents = 0;
+        double recoExpectedEvents = 0.0;
+        double trueExpectedEvents = 0.0;
+        // Fit errors before the scaling to the expected EIC yield (the pairs above hold the scaled ones)
+        double recoRawError = 0.0;
+        double trueRawError = 0.0;
+        // Binned fits: fraction of the per-event information lost to the analyzing-power cells
+        double recoBinningInfoLoss = 0.0;
+        double trueBinningInfoLoss = 0.0;
+        // Multi-modulation extraction: (amplitude, error) of each modulation and their correlation matrix (row-major);
+        // reco/truth then hold the first modulation
+        std::vector<std::pair<double, double>> recoModulations, trueModulations;
+        std::vector<double> recoModulationCorrelation, trueModulationCorrelation;
+        // Aggregated fits: super-events fitted and relative change of the error (at A = 0) from the merging
+        int recoSuperEvents = 0;
+        int trueSuperEvents = 0;
+        double recoAggregationErrorChange = 0.0;
+        double trueAggregationErrorChange = 0.0;
+    };
+
+    Inject(EventSource* source, const Table* table, double scale = 1.0, double targetPolarization = 1.0);
     ~Inject();
-    std::pair<double, double> injectExtractForBin(const Bin& bin, bool extract_with_true, std::optional<double> A_opt = std::nullopt);
+    // injection: toy number; with the seed and bin id it keys the spin random stream, so a toy is reproducible
+    std::pair<double, double> injectExtractForBin(const Bin& bin, bool extract_with_true, std::optional<double> A_opt = std::nullopt,
+                                                  int injection = 0);
+    // Injects spins once from the true kinematics and fits both the reco-binned and the true-binned datasets
+    DualResult injectExtractBothForBin(const Bin& bin, std::optional<double> A_opt = std::nullopt, int injection = 0);
+
+    // Reads the events of a bin once; withTable also looks up their table asymmetries
+    PreparedBin prepare(const Bin& bin, bool fitsReco, bool fitsTrue, bool withTable);
+    // Spin draw and fit of one toy of a prepared bin. stream selects an independent random stream
+    // (e.g. per scan point); toys sharing it reuse the same uniforms per event.
+    DualResult injectExtract(const PreparedBin& prep, const Point& point, int injection, uint32_t stream = 0) const;
+    // Asimov fit of a prepared bin: every event enters with both spin states weighted by their expected
+    // probabilities, and the single fit gives the central value and the median expected error of the toys
+    DualResult injectExtractAsimov(const PreparedBin& prep, const Point& point) const;
+    // Poisson bootstrap: injects once, then fits `replicas` Poisson(1)-reweighted copies of that dataset with the
+    // unbinned single-amplitude likelihood. The spread of the replicas replaces that of independent toys. Replicas
+    // whose fit did not converge or ended at the amplitude bound have NaN errors.
+    std::vector<DualResult> bootstrap(const PreparedBin& prep, const Point& point, int replicas, uint32_t stream = 0) const;
+
+    void setRandomStream(uint64_t s, uint32_t bin) { seed = s; binId = bin; }
+    // Restrict the event loop to pre-selected entries (see BinIndex); nullptr scans the whole input
+    void setSelection(const EntryBitmap* sel) { selection = sel; }
+    // Entries of the input the event loop may visit (default: all)
+    void setEventRange(const EventRange& r) { range = r; }
+    // Reuse table AUT lookups across calls (must be built from the same table); nullptr looks them up every time
+    void setAUTCache(AUTCache* cache) { autCache = cache; }
+    // Fit a binned likelihood over nCells >= 2 analyzing-power cells instead of the unbinned RooFit fit (0: unbinned).
+    // Applies to bins prepared afterwards.
+    void setBinnedFit(int nCells);
+    // Inject and extract these modulations together (empty: the single sin(PhiH + PhiS) amplitude).
+    // Applies to bins prepared afterwards.
+    void setModulations(const std::vector<Modulation>& m) { modulations = m; }
+    // Unbinned fits take their errors from RooFit (HESSE with SumW2Error) instead of the closed-form sandwich
+    // covariance; slower, kept to validate the closed form
+    void setRooFitErrors(bool r) { rooFitErrors = r; }
+    // Merge the events of unbinned fits into super-events of equal signed analyzing power P g s, within this
+    // tolerance, and fit those instead of a RooDataSet (0: no merging; otherwise in [1e-6, 1], the sink holds about
+    // 2 / tolerance cells). Modulations and binned fits take precedence over it.
+    void setAggregation(double tolerance);
+    // Print the result of every fit and the progress of bin preparation (default on; concurrent injectors turn it
+    // off, their output would interleave)
+    void setVerbose(bool v) { verbose = v; }
 
 private:
-    TTree* tree;
+    // Buffers reused by every injection of this injector (defined in Inject.cpp); an injector runs one
+    // injection at a time, so concurrent workers each use their own
+    struct Scratch;
+
+    DualResult runToy(const PreparedBin& prep, const Point& point, int injection, uint32_t stream, bool asimov) const;
+    EventSource* source;
     const Table* table;
     double m_scale{1.0};
     double targetPolarization{1.0};
+    const EntryBitmap* selection = nullptr;
+    EventRange range;
+    AUTCache* autCache = nullptr;
+    uint64_t seed = 0;
+    uint32_t binId = 0;
+    int binnedCells = 0;
+    std::vector<Modulation> modulations;
+    bool rooFitErrors = false;
+    double aggregationTolerance = 0.0;
+    bool verbose = true;
+    std::unique_ptr<Scratch> scratch;
 };
 
 #endif // INJECT_H
@@ -1,18 +1,22 @@
 #ifndef INJECTION_PROJECT_H
 #define INJECTION_PROJECT_H
 
+#include "AUTCache.h"
 #include "Bin.h"
+#include "BinIndex.h"
 #include "Grid.h"
 #include "TCut.h"
-#include "TTree.h"
+#include "EventSource.h"
 #include "Table.h"
 #include "Inject.h"
 #include "Logger.h"
+#include <algorithm>
 #include <optional>
 #include <string>
 #include <vector>
 #include <tuple>
 #include <filesystem>
+#include <memory>
 
 // Small utility to run many inject/extract trials across bins and emit a YAML summary
 class InjectionProject {
@@ -23,16 +27,100 @@ public:
         int n = 1;
         bool extract_with_true = false;
         std::optional<double> A_opt;
+        // Inject once from the true kinematics and fit both the reco-binned and the true-binned datasets
+        bool extract_both = false;
+        // Response-curve scan: injected amplitudes and/or target polarizations (replace A_opt and the
+        // project polarization). The bin is read once and every point only redraws the spins and refits.
+        std::vector<double> A_scan;
+        std::vector<double> polarization_scan;
+        // Every scan point reuses the same uniforms per event and injection, so differences between
+        // points are paired (written as paired_difference to the first point)
+        bool common_random_numbers = false;
+        // Adaptive injection count: if target_precision > 0, inject until the standard errors of
+        // mean_extracted and stddev_extracted are below it, between min_injections and max_injections
+        // (max_injections <= 0 uses n)
+        double target_precision = 0.0;
+        int min_injections = 5;
+        int max_injections = 0;
+        // One Asimov fit per point instead of n toys (central value and median expected error)
+        bool asimov = false;
+        // Binned-likelihood fit over this many analyzing-power cells instead of the unbinned fit (0: unbinned)
+        int binned = 0;
+        // Modulations injected and extracted together ("collins", "sivers", "pretzelosity"); empty: the single
+        // sin(PhiH + PhiS) amplitude. A_modulations are their injected amplitudes; missing entries inject the
+        // point's amplitude (A_opt, scan or table) for Collins and 0 for the others.
+        std::vector<std::string> modulations;
+        std::vector<double> A_modulations;
+        // Poisson bootstrap: inject once and fit n Poisson(1)-reweighted replicas instead of n toys
+        bool bootstrap = false;
+        // Unbinned fits merge events into super-events of equal signed analyzing power within this tolerance (0: off)
+        double aggregate = 0.0;
     };
 
-    InjectionProject(const std::string& filename, TTree* tree, const Table* table, double scale, const Grid* grid, double targetPolarization, const std::string& outDir, const std::string& outFilename);
+    InjectionProject(const std::string& filename, EventSource* source, const Table* table, double scale, const Grid* grid, double targetPolarization, const std::string& outDir, const std::string& outFilename);
     void addJob(const Job& job);
+    void setBinIndex(const BinIndex* index) { binIndex = index; }
+    void setEventRange(const EventRange& range) { eventRange = range; }
+    // Persist the per-entry AUT lookups to this file (loaded on the first run, updated after each run)
+    void setAUTCacheFile(const std::string& path) { autCacheFile = path; }
+    // Seed of the spin random streams (toys are keyed by seed, bin index and injection number)
+    void setSeed(uint64_t s) { seed = s; }
+    // Reuse the finished jobs recorded in the journal (<outPrefix>.journal) of an earlier, interrupted run
+    void setResume(bool r) { resume = r; }
+    // Start a fresh journal even if one exists (takes precedence over setResume). With neither, run() refuses to
+    // start when the journal holds records, so a rerun never discards the jobs of a killed run.
+    void setOverwrite(bool o) { overwrite = o; }
+    // Jobs run concurrently on this many workers, as (bin, injection) tasks of a work-stealing scheduler
+    // (see TaskScheduler). Toys are keyed by bin and injection number, so the results do not depend on it.
+    void setThreads(int n) { nThreads = std::max(1, n); }
     bool run();
 
 private:
+    // Settings, prepared events and results of one job, from the preparation of its bin to its YAML map
+    struct JobRun {
+        const Job* job = nullptr;
+        const Bin* bin = nullptr;
+        std::vector<Modulation> modulations;
+        std::vector<Inject::Point> points;
+        bool isScan = false;
+        bool fitsReco = false;
+        bool fitsTrue = false;
+        bool withTable = false;
+        bool adaptive = false;
+        int nMax = 0;
+        int nMin = 0;
+        EntryBitmap selection;
+        PreparedBin prep; // read once, shared by every injection of the job
+        std::vector<std::vector<Inject::DualResult>> results;
+        int nDone = 0;
+        bool converged = false;
+        std::pair<double, double> se{0.0, 0.0};
+        // Fixed-count toy jobs can run their injections as independent tasks
+        bool splitsInjections() const { return !adaptive && !job->asimov && !job->bootstrap; }
+    };
+
+    // Runs one job and returns its YAML map
+    std::string runJob(const Job& job, const Bin& bin);
+    void planJob(JobRun& run, const Job& job, const Bin& bin) const;
+    // Injector reading through reader with the project settings, and its settings for one job
+    std::unique_ptr<Inject> makeInjector(EventSource* reader) const;
+    void bindInjector(Inject& injector, const JobRun& run) const;
+    // Reads the events of the bin through the injector's reader
+    void prepareJob(JobRun& run, Inject& injector) const;
+    // Every injection of the job in order, stopping early in adaptive mode
+    void runInjections(JobRun& run, Inject& injector) const;
+    // Injection i of every point, into results[p][i] (fixed-count jobs)
+    void runInjection(JobRun& run, Inject& injector, int i) const;
+    std::string emitJob(const JobRun& run) const;
+    // Identifies the input, table, grid and project settings every job depends on
+    std::string projectKey() const;
+    // Identifies a job and its bin (appended to projectKey() in the journal)
+    std::string jobKey(const Job& job, const Bin& bin) const;
+    // Writes the summary of the given job maps atomically (temporary file + rename)
+    bool writeSummary(const std::vector<std::string>& jobYaml) const;
 
     std::string filename;
-    TTree* tree;
+    EventSource* source;
     std::string outPrefix;
     const Table* table;
     double scale;
@@ -41,6 +129,14 @@ private:
     std::string outDir;
     std::string outFilename;
     std::vector<Job> jobs;
+    const BinIndex* binIndex = nullptr;
+    EventRange eventRange;
+    std::unique_ptr<AUTCache> autCache; // shared by every job of the project
+    std::string autCacheFile;
+    uint64_t seed = 0;
+    bool resume = false;
+    bool overwrite = false;
+    int nThreads = 1;
 };
 
 #endif // INJECTION_PROJECT_H
@@ -0,0 +1,51 @@
+#ifndef KINEMATICS_H
+#define KINEMATICS_H
+
+#include <cstddef>
+#include <vector>
+
+// Spin-transfer quantities of a batch of events, stored as structure of arrays.
+// For each event (X, Q2, Y, PhiH, PhiS) the kernel computes
+//   Gamma  = 2 X M / sqrt(Q2)                    (0 if Q2 <= 0)
+//   S_T    = cos(theta) / sqrt(1 - sin^2(theta) sin^2(PhiS)),  sin(theta) = Gamma sqrt((1 - Y - Y^2 Gamma^2 / 4) / (1 + Gamma^2))
+//   Depol  = (1 - Y) / (1 - Y + Y^2 / 2)
+//   SinPhi = sin(PhiH + PhiS)
+// Vector kernels (AVX2, AVX-512) are picked at run time and agree with the scalar reference to 1e-12.
+class KinematicsBatch {
+public:
+    enum class Isa { Scalar, AVX2, AVX512 };
+    // Widest instruction set supported by the running CPU
+    static Isa bestIsa();
+    static const char* isaName(Isa isa);
+
+    void clear();
+    void reserve(size_t n);
+    void push(double x, double q2, double y, double phiH, double phiS) {
+        X.push_back(x);
+        Q2.push_back(q2);
+        Y.push_back(y);
+        PhiH.push_back(phiH);
+        PhiS.push_back(phiS);
+    }
+    size_t size() const {
+        return X.size();
+    }
+
+    // Fills the outputs for every pushed event
+    void compute() {
+        compute(bestIsa());
+    }
+    void compute(Isa isa);
+
+    // Inputs
+    std::vector<double> X, Q2, Y, PhiH, PhiS;
+    // Outputs
+    std::vector<double> Gamma, S_T, Depol, SinPhi;
+
+private:
+    void computeScalar(size_t begin, size_t end);
+    size_t computeAVX2(size_t n);
+    size_t computeAVX512(size_t n);
+};
+
+#endif // KINEMATICS_H
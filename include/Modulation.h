@@ -0,0 +1,51 @@
+#ifndef MODULATION_H
+#define MODULATION_H
+
+#include <cmath>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Azimuthal modulation of the transverse-target single-spin asymmetry. The spin-dependent part of the
+// cross section is S_T sum_m A_m D_m(y) f_m(PhiH, PhiS), with D_m = 1 for Sivers and the depolarization
+// (1 - y)/(1 - y + y^2/2) for Collins and pretzelosity.
+struct Modulation {
+    enum class Kind { Collins, Sivers, Pretzelosity };
+    Kind kind = Kind::Collins;
+
+    // "collins", "sivers" or "pretzelosity" (any case); nullopt otherwise
+    static std::optional<Modulation> parse(const std::string& name);
+    const char* name() const;
+    bool usesDepolarization() const {
+        return kind != Kind::Sivers;
+    }
+    double f(double phiH, double phiS) const {
+        switch (kind) {
+        case Kind::Sivers:
+            return std::sin(phiH - phiS);
+        case Kind::Pretzelosity:
+            return std::sin(3 * phiH - phiS);
+        default:
+            return std::sin(phiH + phiS);
+        }
+    }
+};
+
+// Weighted second and fourth moments of a modulation basis b_m = S_T D_m f_m over a dataset.
+// They do not depend on the spins, so a bin accumulates them once and every injection reuses them.
+struct ModulationMoments {
+    int K = 0;
+    std::vector<double> m2; // sum w b_i b_j       (K x K)
+    std::vector<double> m4; // sum w b_i b_j b_k b_l (K^4)
+
+    void reset(int k);
+    void add(const double* b, double w);
+};
+
+// Method-of-moments amplitudes from the spin moment v = sum w s b of a dataset. With E[s] = P A.b,
+// E[v] = P M2 A, so A = M2^-1 v / P is unbiased; its covariance is M2^-1 (M2 - P^2 Q(A)) M2^-1 / P^2 with
+// Q(A)_ij = sum_kl m4_ijkl A_k A_l. Returns false if M2 is singular (e.g. an empty or degenerate bin).
+bool solveModulations(const ModulationMoments& moments, const std::vector<double>& v, double polarization, std::vector<double>& A,
+                      std::vector<double>& cov);
+
+#endif // MODULATION_H
@@ -0,0 +1,57 @@
+#ifndef REDUCTION_H
+#define REDUCTION_H
+
+#include <cmath>
+#include <cstddef>
+
+// Deterministic floating-point reductions. The engines accumulate weighted sums with CompensatedSum and combine
+// partial sums along a tree fixed by the data (the input files, in file order), never by the threads, so a run
+// gives bit-identical results on any number of threads. Both rely on IEEE rounding: do not build with -ffast-math.
+
+// Neumaier's compensated sum: the rounding error of every addition is kept in a second term, so the sum stays
+// accurate to a few ulps whatever the count and the dynamic range of the addends (e.g. 1e8 weights from 1e-3 to 1e4).
+class CompensatedSum {
+public:
+    void add(double x) {
+        const double t = sum + x;
+        if (std::abs(sum) >= std::abs(x))
+            compensation += (sum - t) + x;
+        else
+            compensation += (x - t) + sum;
+        sum = t;
+    }
+    CompensatedSum& operator+=(double x) {
+        add(x);
+        return *this;
+    }
+    // Adds a partial sum (e.g. of another input file)
+    void merge(const CompensatedSum& other) {
+        add(other.sum);
+        compensation += other.compensation;
+    }
+    double value() const {
+        return sum + compensation;
+    }
+
+private:
+    double sum = 0.0;
+    double compensation = 0.0;
+};
+
+// Pairwise sum of term(i) for i in [begin, end): runs of up to kPairwiseBlock terms are summed in order and combined
+// by halving at block boundaries, so the tree only depends on the range and the error grows as log(n).
+constexpr size_t kPairwiseBlock = 64;
+template <typename F>
+double pairwiseSum(size_t begin, size_t end, F&& term) {
+    if (end - begin <= kPairwiseBlock) {
+        double s = 0.0;
+        for (size_t i = begin; i < end; ++i)
+            s += term(i);
+        return s;
+    }
+    const size_t blocks = (end - begin + kPairwiseBlock - 1) / kPairwiseBlock;
+    const size_t mid = begin + (blocks / 2) * kPairwiseBlock;
+    return pairwiseSum(begin, mid, term) + pairwiseSum(mid, end, term);
+}
+
+#endif // REDUCTION_H
@@ -1,11 +1,14 @@
 #ifndef TMD_H
 #define TMD_H
 
+#include "BinCut.h"
+#include "BinIndex.h"
+#include "ErrorProjection.h"
+#include "EventRange.h"
+#include "EventSource.h"
 #include "Grid.h"
-#include "Hist.h"
 #include "Inject.h"
 #include "InjectionProject.h"
-#include "Plotter.h"
 #include "TCut.h"
 #include "TFile.h"
 #include "TH1D.h"
@@ -17,6 +20,9 @@
 #include <vector>
 #include <optional>
 
+class Hist;
+class Plotter;
+
 class TMD {
 public:
     TMD(const std::string& filename, const std::string& treename);
@@ -24,34 +30,63 @@ public:
     double getTargetPolarization() const { return targetPolarization; }
     void setOutDir(const std::string& dir) { outDir = dir; }
     void setOutFilename(const std::string& fname) { outFilename = fname; }
+    // Seed of the reproducible spin random streams used by injections
+    void setSeed(unsigned long long s) { seed = s; }
+    // Skip injection jobs already recorded in the journal of an interrupted run (default false)
+    void setResumeInjections(bool r) { resumeInjections = r; }
+    // Truncate an existing injection journal instead of refusing to run (default false, takes precedence over resume)
+    void setOverwriteInjections(bool o) { overwriteInjections = o; }
     ~TMD();
     bool isLoaded() const;
+    // Shorthand for setEventRange(EventRange::firstN(maxEntries)); ignored if maxEntries <= 0
     void setMaxEntries(Long64_t maxEntries);
+    // Entries processed by histogramming, injection and the bin index; the scale follows the processed fraction
+    void setEventRange(const EventRange& range);
+    const EventRange& getEventRange() const;
+    // Worker threads for multi-file passes (histogram filling, bin index)
+    void setThreads(int n);
     TTree* getTree() const;
     std::map<std::string, TCut> generateBinTCuts(const Grid& grid) const;
+    std::map<std::string, BinCut> generateBinCuts(const Grid& grid) const;
+    EventSource* getSource() const;
     void loadTable();
     void loadTable(const std::string& tablePath, const std::string& energyConfig);
     void buildGrid(const std::vector<std::string>& binNames);
+    // Build (or load from outDir) the per-row selection bitmaps used for sparse entry access
+    void buildBinIndex(bool overwrite = false);
+    const BinIndex* getBinIndex() const;
     const Table* getTable() const;
     const Grid* getGrid() const;
     const std::map<std::string, TCut>& getBinTCuts() const;
+    // Histogramming and plotting live in the plotting library (src/TMDPlots.cpp, libtmdplot): non-plotting binaries
+    // link only libtmdcore
     void fillHistograms(const std::string& var, const std::string& outDir = "out", bool overwrite = false);
     void plot1DBin(const std::string& var, size_t binIndex, const std::string& outpath = "");
     void plot2DMap(const std::string& var, const std::string& outpath);
     void queueInjection(const InjectionProject::Job& job);
     void runQueuedInjections();
+    // Analytic expected error on A for every grid bin from one pass (see ErrorProjection); toyYaml is an
+    // optional inject summary to cross-check against. Written to outDir/outFilename, or projection_<file>_<tree>.yaml.
+    // fastToys > 0 also samples that many toys per bin from cached (PhiH + PhiS, S_T Depol) densities.
+    bool projectErrors(double amplitude = 0.0, const std::string& toyYaml = "", int fastToys = 0);
 
     TFile* file;
-    TTree* tree;
-    std::string filename;
+    TTree* tree;                          // nullptr for RNTuple input
+    std::unique_ptr<EventSource> source;  // column reader shared by Hist, Inject and BinIndex
+    std::string filename;                 // input specification (file, glob, list or comma-separated)
+    std::vector<std::string> inputFiles;  // files it expands to
     std::string treename;
     std::string energyConfig; // stored for cache naming
     std::unique_ptr<Table> table;
     std::unique_ptr<Grid> grid;
     std::vector<std::string> binNames; // mainBinNames (ex: <"X", "Q">)
     std::map<std::string, TCut> binTCuts;
-    std::unique_ptr<Hist> hist;
-    std::unique_ptr<Plotter> plotter;
+    std::map<std::string, BinCut> binCuts;
+    // Created on first use by the plotting methods; shared_ptr keeps the deleter with the plotting library, so
+    // destroying a TMD does not reference it
+    std::shared_ptr<Hist> hist;
+    std::shared_ptr<Plotter> plotter;
+    std::unique_ptr<BinIndex> binIndex;
     InjectionProject* proj = nullptr;
 
     // MC and scaling information
@@ -65,6 +100,18 @@ public:
     double targetPolarization{1.0};
     std::string outDir{"out"};
     std::string outFilename;
+    int nThreads{1};
+    unsigned long long seed{0};
+    bool resumeInjections{false};
+    bool overwriteInjections{false};
+    EventRange eventRange;
+
+private:
+    void loadMetadata();
+    void updateScale();
+    // Lazily created plotting components; the histogrammer follows the current threads and event range
+    Hist& getHist();
+    Plotter& getPlotter();
 };
 
 #endif // TMD_H
\ No newline at end of file
@@ -31,6 +31,9 @@ public:
     // Fast lookup of AUT given X, Q, Z, and PhPerp
     double lookupAUT(double X, double Q, double Z, double PhPerp) const;
 
+    // Hash of every row (bounds and AUT); identifies the table in cache files
+    unsigned long long contentHash() const;
+
 private:
     std::vector<TableRow> rows;
     void readTable(const std::string& filename);
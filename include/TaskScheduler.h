@@ -0,0 +1,48 @@
+#ifndef TASK_SCHEDULER_H
+#define TASK_SCHEDULER_H
+
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Work-stealing pool for tasks of very uneven cost (e.g. the bins of a grid, from a few to 200k events).
+// Queued tasks are started in order from a shared queue. A task may spawn tasks, which go to the deque of its
+// worker: a worker runs its own tasks newest first, and an idle worker steals the oldest task of another worker
+// before it starts a new queued one. The spawned injections of a large bin are thus spread over every idle worker,
+// while small bins finish on the worker that prepared them.
+class TaskScheduler {
+public:
+    using Task = std::function<void()>;
+
+    explicit TaskScheduler(int nThreads);
+    int threads() const { return nThreads; }
+    // Called from a task, the task goes to the calling worker's deque; otherwise it is queued for run()
+    void spawn(Task task);
+    // Runs the queued tasks and every task they spawn, and returns when all are done. The first exception
+    // thrown by a task is rethrown here, after the other tasks have finished.
+    void run();
+    // Index of the calling worker in [0, threads()), or -1 outside a task
+    static int workerIndex();
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+    bool next(int w, Task& task);
+    void work(int w);
+
+    int nThreads;
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::mutex queueMutex;
+    std::deque<Task> queue;
+    std::atomic<long> pending{0};
+    std::mutex errorMutex;
+    std::exception_ptr error;
+};
+
+#endif // TASK_SCHEDULER_H
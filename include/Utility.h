@@ -1,12 +1,20 @@
 #ifndef UTILITY_H
 #define UTILITY_H
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cmath>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <glob.h>
 #include <iostream>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <map>
+#include <vector>
 #include "Constants.h"
 
 namespace util {
@@ -127,4 +135,94 @@ inline double computeScale(long long totalEvents, double xsTotal, const std::str
 
 } // namespace util
 
+namespace util {
+
+// Expand an input specification into a sorted list of files. Accepted forms:
+//   file.root                     a single file
+//   "dir/run_*.root"              a glob pattern (quote it on the command line)
+//   files.txt / files.list        a text file with one path (or glob) per line, '#' comments allowed
+//   a.root,b.root                 a comma-separated list of any of the above
+inline std::vector<std::string> expandInputFiles(const std::string& spec) {
+    std::vector<std::string> files;
+    size_t start = 0;
+    while (start <= spec.size()) {
+        size_t end = spec.find(',', start);
+        if (end == std::string::npos)
+            end = spec.size();
+        std::string item = spec.substr(start, end - start);
+        start = end + 1;
+        if (item.empty())
+            continue;
+        std::string ext = std::filesystem::path(item).extension().string();
+        if (ext == ".txt" || ext == ".list") {
+            std::ifstream in(item);
+            std::string line;
+            while (std::getline(in, line)) {
+                line.erase(0, line.find_first_not_of(" \t"));
+                line.erase(line.find_last_not_of(" \t\r") + 1);
+                if (line.empty() || line[0] == '#')
+                    continue;
+                auto sub = expandInputFiles(line);
+                files.insert(files.end(), sub.begin(), sub.end());
+            }
+        } else if (item.find_first_of("*?[") != std::string::npos) {
+            glob_t g;
+            if (glob(item.c_str(), 0, nullptr, &g) == 0) {
+                std::vector<std::string> matched(g.gl_pathv, g.gl_pathv + g.gl_pathc);
+                std::sort(matched.begin(), matched.end());
+                files.insert(files.end(), matched.begin(), matched.end());
+            }
+            globfree(&g);
+        } else {
+            files.push_back(item);
+        }
+    }
+    return files;
+}
+
+// File-name-safe stem of an input specification (used for cache and output names)
+inline std::string inputStem(const std::string& spec) {
+    std::string stem = std::filesystem::path(spec.substr(0, spec.find(','))).stem().string();
+    for (char& c : stem) {
+        if (c == '*' || c == '?' || c == '[' || c == ']')
+            c = '_';
+    }
+    return stem;
+}
+
+// Run fn(i) for i in [0, n) on up to nThreads threads. Work is handed out one index at a time;
+// the first exception thrown by a worker is rethrown in the caller.
+template <typename F>
+void parallelFor(size_t n, int nThreads, F&& fn) {
+    const size_t nWorkers = std::min<size_t>(n, static_cast<size_t>(std::max(1, nThreads)));
+    if (nWorkers <= 1) {
+        for (size_t i = 0; i < n; ++i)
+            fn(i);
+        return;
+    }
+    std::atomic<size_t> next{0};
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    std::vector<std::thread> workers;
+    for (size_t w = 0; w < nWorkers; ++w) {
+        workers.emplace_back([&]() {
+            for (size_t i = next++; i < n; i = next++) {
+                try {
+                    fn(i);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!error)
+                        error = std::current_exception();
+                }
+            }
+        });
+    }
+    for (auto& t : workers)
+        t.join();
+    if (error)
+        std::rethrow_exception(error);
+}
+
+} // namespace util
+
 #endif // UTILITY_H
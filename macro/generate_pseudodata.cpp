@@ -3,6 +3,8 @@
 #include <TTree.h>
 #include <TRandom3.h>
 #include <TMath.h>
+#include <ROOT/RNTupleModel.hxx>
+#include <ROOT/RNTupleWriter.hxx>
 #include <vector>
 #include <iostream>
 
@@ -11,6 +13,7 @@
 int main() {
 
     const std::string outpath = "out/output.root";
+    const std::string ntuplePath = "out/output_rntuple.root"; // same events as an RNTuple
 
     // Create a small toy tree
     TFile fout(outpath.c_str(), "RECREATE");
@@ -39,6 +42,19 @@ int main() {
     tree.Branch("Weight", &Weight, "Weight/D");
     tree.Branch("Spin_idx", &Spin_idx, "Spin_idx/I");
 
+    // RNTuple copy with the same field names as the TTree branches
+    TFile fntuple(ntuplePath.c_str(), "RECREATE");
+    auto model = ROOT::RNTupleModel::Create();
+    std::vector<std::pair<double*, std::shared_ptr<double>>> fields;
+    for (auto& nv : std::vector<std::pair<const char*, double*>>{
+             {"X", &X}, {"Q2", &Q2}, {"Z", &Z}, {"PhPerp", &PhPerp}, {"PhiH", &PhiH}, {"PhiS", &PhiS}, {"Y", &Y},
+             {"TrueX", &TrueX}, {"TrueQ2", &TrueQ2}, {"TrueZ", &TrueZ}, {"TruePhPerp", &TruePhPerp},
+             {"TruePhiH", &TruePhiH}, {"TruePhiS", &TruePhiS}, {"TrueY", &TrueY}, {"Weight", &Weight}}) {
+        fields.emplace_back(nv.second, model->MakeField<double>(nv.first));
+    }
+    auto spinField = model->MakeField<int>("Spin_idx");
+    auto writer = ROOT::RNTupleWriter::Append(std::move(model), "tree", fntuple);
+
     TRandom3 rng(516);
     const int N = 20000;
     for (int i = 0; i < N; ++i) {
@@ -61,8 +77,14 @@ int main() {
         Weight = 1.0f;
         Spin_idx = 0;
         tree.Fill();
+        for (auto& f : fields)
+            *f.second = *f.first;
+        *spinField = Spin_idx;
+        writer->Fill();
     }
+    writer.reset(); // commit the RNTuple before adding metadata
 
+    fout.cd(); // the RNTuple file became the current directory above
     tree.Write();
 
     std::vector<double> XsTotal; XsTotal.push_back(1.0);
@@ -70,6 +92,9 @@ int main() {
     fout.WriteObject(&XsTotal, "XsTotal");
     fout.WriteObject(&TotalEvents, "TotalEvents");
     fout.Close();
+    fntuple.WriteObject(&XsTotal, "XsTotal");
+    fntuple.WriteObject(&TotalEvents, "TotalEvents");
+    fntuple.Close();
 
     return 0;
 }
\ No newline at end of file
@@ -16,23 +16,35 @@ int main(int argc, char** argv) {
         return 1;
     }
     LOG_INFO("[main.cpp] Successfully loaded ROOT file and TTree.");
-    tmd.setMaxEntries(args.maxEntries);
+    tmd.setThreads(args.nThreads);
+    tmd.setEventRange(makeEventRange(args));
     if (args.maxEntries > 0)
         LOG_INFO("[main.cpp] Set max entries to: " + std::to_string(args.maxEntries));
     tmd.setTargetPolarization(args.targetPolarization);
     LOG_INFO("[main.cpp] Set target polarization to " + std::to_string(args.targetPolarization));
     tmd.setOutDir(args.outDir);
     tmd.setOutFilename(args.outFilename);
+    tmd.setSeed(args.seed);
+    tmd.setResumeInjections(args.resume);
+    tmd.setOverwriteInjections(args.overwrite);
     if(args.table.empty()){
         LOG_FATAL("Table not specified. Use --table </path/to/table.csv>");
     }
     tmd.loadTable(args.table,args.energyConfig);
+    if (args.useBinIndex) {
+        tmd.buildBinIndex(args.overwrite);
+    }
 
     if(args.grid.empty()) {
         LOG_FATAL("Grid variables not specified. Use --grid <var1,var2,...>");
         return 1;
     }
     tmd.buildGrid( args.grid );
+    if (args.all_bins) {
+        args.bin_index_start = 0;
+        args.bin_index_end = static_cast<int>(tmd.getGrid()->getBins().size()) - 1;
+        LOG_INFO("[main.cpp] Queueing all " + std::to_string(args.bin_index_end + 1) + " bins on " + std::to_string(args.nThreads) + " threads");
+    }
     // If bin_index_start and bin_index_end are set, queue that range of bins
     if (args.bin_index_end >= args.bin_index_start) {
         for (int bin_idx = args.bin_index_start; bin_idx <= args.bin_index_end; ++bin_idx) {
@@ -40,7 +52,20 @@ int main(int argc, char** argv) {
                 .bin_index = bin_idx,
                 .n = args.n_injections,
                 .extract_with_true = args.extract_with_true,
-                .A_opt = args.A_opt
+                .A_opt = args.A_opt,
+                .extract_both = args.extract_both,
+                .A_scan = args.A_scan,
+                .polarization_scan = args.polarization_scan,
+                .common_random_numbers = args.common_random_numbers,
+                .target_precision = args.target_precision,
+                .min_injections = args.min_injections,
+                .max_injections = args.max_injections,
+                .asimov = args.asimov,
+                .binned = args.binned,
+                .modulations = args.modulations,
+                .A_modulations = args.A_modulations,
+                .bootstrap = args.bootstrap,
+                .aggregate = args.aggregate
             });
         }
     } else {
@@ -49,7 +74,20 @@ int main(int argc, char** argv) {
             .bin_index = args.bin_index,
             .n = args.n_injections,
             .extract_with_true = args.extract_with_true,
-            .A_opt = args.A_opt
+            .A_opt = args.A_opt,
+            .extract_both = args.extract_both,
+            .A_scan = args.A_scan,
+            .polarization_scan = args.polarization_scan,
+            .common_random_numbers = args.common_random_numbers,
+            .target_precision = args.target_precision,
+            .min_injections = args.min_injections,
+            .max_injections = args.max_injections,
+            .asimov = args.asimov,
+            .binned = args.binned,
+            .modulations = args.modulations,
+            .A_modulations = args.A_modulations,
+            .bootstrap = args.bootstrap,
+            .aggregate = args.aggregate
         });
     }
     // Run the queued injections
@@ -16,7 +16,8 @@ int main(int argc, char** argv) {
         return 1;
     }
 
-    tmd.setMaxEntries(args.maxEntries);
+    tmd.setThreads(args.nThreads);
+    tmd.setEventRange(makeEventRange(args));
     if (args.maxEntries > 0)
         LOG_INFO("[make_1d_plots] Set max entries to: " + std::to_string(args.maxEntries));
 
@@ -24,6 +25,10 @@ int main(int argc, char** argv) {
         LOG_FATAL("Table not specified. Use --table </path/to/table.csv>");
     }
     tmd.loadTable(args.table,args.energyConfig);
+    if (args.useBinIndex) {
+        tmd.setOutDir(args.outDir);
+        tmd.buildBinIndex(args.overwrite);
+    }
 
     tmd.buildGrid({"X","Q","Z","PhPerp"});
 
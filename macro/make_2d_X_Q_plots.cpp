@@ -16,7 +16,8 @@ int main(int argc, char** argv) {
         return 1;
     }
     LOG_INFO("[make_2d_X_Q_plots] Successfully loaded ROOT file and TTree.");
-    tmd.setMaxEntries(args.maxEntries);
+    tmd.setThreads(args.nThreads);
+    tmd.setEventRange(makeEventRange(args));
     if (args.maxEntries > 0)
         LOG_INFO("[make_2d_X_Q_plots] Set max entries to: " + std::to_string(args.maxEntries));
     tmd.setTargetPolarization(args.targetPolarization);
@@ -25,6 +26,10 @@ int main(int argc, char** argv) {
         LOG_FATAL("Table not specified. Use --table </path/to/table.csv>");
     }
     tmd.loadTable(args.table,args.energyConfig);
+    if (args.useBinIndex) {
+        tmd.setOutDir(args.outDir);
+        tmd.buildBinIndex(args.overwrite);
+    }
 
     LOG_INFO("[make_2d_X_Q_plots] Successfully loaded table for energy config: " + args.energyConfig);
 
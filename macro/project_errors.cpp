@@ -0,0 +1,33 @@
+#include "Logger.h"
+#include "TMD.h"
+#include "ArgParser.h"
+#include <string>
+
+// Analytic projection of the statistical error on A for every bin of the grid, from one pass over the input
+int main(int argc, char** argv) {
+    Logger::setLevel(Logger::Level::Info);
+    Args args = parseArgs(argc, argv);
+
+    TMD tmd(args.filename, args.treename);
+    if (!tmd.isLoaded()) {
+        LOG_FATAL("Failed to load ROOT file or TTree.");
+        return 1;
+    }
+    tmd.setThreads(args.nThreads);
+    tmd.setEventRange(makeEventRange(args));
+    tmd.setTargetPolarization(args.targetPolarization);
+    tmd.setOutDir(args.outDir);
+    tmd.setOutFilename(args.outFilename);
+    tmd.setSeed(args.seed);
+    if (args.table.empty()) {
+        LOG_FATAL("Table not specified. Use --table </path/to/table.csv>");
+        return 1;
+    }
+    tmd.loadTable(args.table, args.energyConfig);
+    if (args.grid.empty()) {
+        LOG_FATAL("Grid variables not specified. Use --grid <var1,var2,...>");
+        return 1;
+    }
+    tmd.buildGrid(args.grid);
+    return tmd.projectErrors(args.A_opt.value_or(0.0), args.toys, args.fast_toys) ? 0 : 1;
+}
@@ -0,0 +1,91 @@
+#include "AUTCache.h"
+#include "Logger.h"
+#include "TFile.h"
+#include "TTree.h"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+AUTCache::AUTCache(const Table* table)
+    : table(table)
+    , tableHash(table ? table->contentHash() : 0) {}
+
+const AUTCache::Value& AUTCache::insert(Long64_t entry, const Event& ev) {
+    Value v;
+    v.trueAUT = table->lookupAUT(ev.TrueX, std::sqrt(std::max(0.0, ev.TrueQ2)), ev.TrueZ, ev.TruePhPerp);
+    v.recoAUT = table->lookupAUT(ev.X, std::sqrt(std::max(0.0, ev.Q2)), ev.Z, ev.PhPerp);
+    dirty = true;
+    return values.emplace(entry, v).first->second;
+}
+
+bool AUTCache::save(const std::string& cacheFile, Long64_t nEntries) {
+    std::unique_ptr<TFile> f(TFile::Open(cacheFile.c_str(), "RECREATE"));
+    if (!f || f->IsZombie()) {
+        LOG_ERROR("Failed to create AUT cache file: " + cacheFile);
+        return false;
+    }
+    TTree meta("autCacheMeta", "AUT cache metadata");
+    Long64_t entries = nEntries;
+    ULong64_t hash = tableHash;
+    meta.Branch("nEntries", &entries, "nEntries/L");
+    meta.Branch("tableHash", &hash, "tableHash/l");
+    meta.Fill();
+
+    // Written in entry order so the file does not depend on the lookup order
+    std::vector<Long64_t> keys;
+    keys.reserve(values.size());
+    for (const auto& kv : values)
+        keys.push_back(kv.first);
+    std::sort(keys.begin(), keys.end());
+    TTree t("autCache", "Per-entry true/reco AUT");
+    Long64_t entry = 0;
+    double trueAUT = 0.0, recoAUT = 0.0;
+    t.Branch("entry", &entry, "entry/L");
+    t.Branch("trueAUT", &trueAUT, "trueAUT/D");
+    t.Branch("recoAUT", &recoAUT, "recoAUT/D");
+    for (Long64_t k : keys) {
+        entry = k;
+        trueAUT = values.at(k).trueAUT;
+        recoAUT = values.at(k).recoAUT;
+        t.Fill();
+    }
+    f->cd();
+    meta.Write();
+    t.Write();
+    f->Close();
+    dirty = false;
+    LOG_INFO("Saved AUT cache (" + std::to_string(values.size()) + " entries): " + cacheFile);
+    return true;
+}
+
+bool AUTCache::load(const std::string& cacheFile, Long64_t nEntries) {
+    std::unique_ptr<TFile> f(TFile::Open(cacheFile.c_str(), "READ"));
+    if (!f || f->IsZombie())
+        return false;
+    TTree* meta = dynamic_cast<TTree*>(f->Get("autCacheMeta"));
+    TTree* t = dynamic_cast<TTree*>(f->Get("autCache"));
+    if (!meta || !t || meta->GetEntries() != 1)
+        return false;
+    Long64_t entries = 0;
+    ULong64_t hash = 0;
+    meta->SetBranchAddress("nEntries", &entries);
+    meta->SetBranchAddress("tableHash", &hash);
+    meta->GetEntry(0);
+    if (entries != nEntries || hash != tableHash) {
+        LOG_WARN("AUTCache: cache " + cacheFile + " does not match the current input/table; ignoring it.");
+        return false;
+    }
+    Long64_t entry = 0;
+    double trueAUT = 0.0, recoAUT = 0.0;
+    t->SetBranchAddress("entry", &entry);
+    t->SetBranchAddress("trueAUT", &trueAUT);
+    t->SetBranchAddress("recoAUT", &recoAUT);
+    values.reserve(values.size() + static_cast<size_t>(t->GetEntries()));
+    for (Long64_t i = 0; i < t->GetEntries(); ++i) {
+        t->GetEntry(i);
+        values[entry] = Value{trueAUT, recoAUT};
+    }
+    LOG_INFO("Loaded AUT cache (" + std::to_string(values.size()) + " entries) from: " + cacheFile);
+    return true;
+}
@@ -1,8 +1,26 @@
 #include "ArgParser.h"
 #include "Logger.h"
+#include "Modulation.h"
+#include <algorithm>
+#include <fstream>
 #include <iostream>
+#include <stdexcept>
+#include <sstream>
 #include <string>
 
+namespace {
+// Comma-separated list of numbers, e.g. "0,0.05,0.1"
+std::vector<double> parseDoubleList(const std::string& list) {
+    std::vector<double> values;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ','))
+        if (!item.empty())
+            values.push_back(std::stod(item));
+    return values;
+}
+} // namespace
+
 Args parseArgs(int argc, char** argv) {
     // If user asked for help, print usage and exit regardless of other args
     for (int i = 1; i < argc; ++i) {
@@ -11,22 +29,47 @@ Args parseArgs(int argc, char** argv) {
             LOG_INFO("Usage (flags): --file <ROOT file> --tree <TTree name> --energy <energy config> [options]");
             LOG_INFO("Or (positional): <ROOT file> <TTree name> <energy config> [options]");
             LOG_INFO("Options:");
-            LOG_INFO("  --file <ROOT file>         Input ROOT file");
+            LOG_INFO("  --file <ROOT file>         Input ROOT file, quoted glob, .txt/.list file list, or comma-separated list");
             LOG_INFO("  --tree <TTree name>        Name of TTree inside the file");
             LOG_INFO("  --energy <energy config>   Energy configuration identifier");
             LOG_INFO("  --table <table path>       Path to the table .csv");
             LOG_INFO("  --overwrite, -f            Overwrite outputs");
+            LOG_INFO("  --resume                   Reuse the jobs finished by an earlier, interrupted inject run (an existing journal needs --resume or --overwrite)");
             LOG_INFO("  --outDir <dir>             Output directory (default out)");
-            LOG_INFO("  --maxEntries <N>           Max entries to process");
+            LOG_INFO("  --useBinIndex              Build/load per-bin entry bitmaps for sparse reads");
+            LOG_INFO("  --maxEntries <N>           Max entries to process (counted from --firstEntry)");
+            LOG_INFO("  --firstEntry <N>           First entry to process");
+            LOG_INFO("  --lastEntry <N>            Stop before this entry");
+            LOG_INFO("  --stride <K>               Process every K-th entry");
+            LOG_INFO("  --fraction <f>             Deterministic hash-based subsample fraction in (0, 1]");
+            LOG_INFO("  --fractionSeed <N>         Seed of the subsample hash (default 0)");
+            LOG_INFO("  --entryList <file>         Text file of entry numbers to process");
+            LOG_INFO("  --threads <N>              Worker threads for multi-file passes and injection jobs (default 1)");
             LOG_INFO("  --outFilename <filename>   Output filename");
             LOG_INFO("  --targetPolarization <v>   Target polarization value");
             LOG_INFO("  --n_injections <N>         Number of injections (default 10)");
+            LOG_INFO("  --seed <N>                 Seed of the spin random streams (default 0)");
             LOG_INFO("  --grid <X,Q,...>           Comma-separated list of grid variables (default X,Q)");
             LOG_INFO("  --bin_index <N>            Bin index to process");
             LOG_INFO("  --bin_index_start <N>  Start bin index (inclusive)");
             LOG_INFO("  --bin_index_end <N>    End bin index (inclusive)");
-            LOG_INFO("  --extract_with_true <t/f>  Extract with true");
+            LOG_INFO("  --bins all                 Inject every bin of the grid (with --threads, load-balanced in one process)");
+            LOG_INFO("  --extract_with_true <t/f/both> Extract with true (both: fit reco- and true-binned data of the same toys)");
             LOG_INFO("  --A_opt <value>            Optional A value");
+            LOG_INFO("  --A_scan <a1,a2,...>       Scan of injected amplitudes (replaces --A_opt)");
+            LOG_INFO("  --pol_scan <p1,p2,...>     Scan of target polarizations");
+            LOG_INFO("  --asimov                   One Asimov-dataset fit per bin instead of n toy injections");
+            LOG_INFO("  --modulations <m1,m2,...>  Inject and extract collins, sivers and/or pretzelosity amplitudes together");
+            LOG_INFO("  --A_mod <a1,a2,...>        Injected amplitudes of the modulations (default: A_opt for collins, 0 otherwise)");
+            LOG_INFO("  --bootstrap                Inject once and fit n_injections Poisson-bootstrap replicas instead of n toys");
+            LOG_INFO("  --binned <N>               Binned-likelihood fit over N analyzing-power cells (reports the information loss)");
+            LOG_INFO("  --aggregate <tol>          Merge events of equal analyzing power (within tol) into weighted super-events");
+            LOG_INFO("  --fast_toys <n>            Toys per bin sampled from cached per-bin densities (project_errors)");
+            LOG_INFO("  --toys <yaml>              Inject summary compared with the projected errors (project_errors)");
+            LOG_INFO("  --crn                      Common random numbers across scan points (paired differences)");
+            LOG_INFO("  --target_precision <e>     Inject until the standard errors of the mean/stddev are below e");
+            LOG_INFO("  --min_injections <N>       Minimum injections in adaptive mode (default 5)");
+            LOG_INFO("  --max_injections <N>       Maximum injections in adaptive mode (default --n_injections)");
             exit(0);
         }
     }
@@ -45,16 +88,36 @@ Args parseArgs(int argc, char** argv) {
             args.table = argv[++i];
         } else if (arg == "--overwrite" || arg == "-f") {
             args.overwrite = true;
+        } else if (arg == "--resume") {
+            args.resume = true;
+        } else if (arg == "--useBinIndex") {
+            args.useBinIndex = true;
         } else if (arg == "--outDir" && i + 1 < argc) {
             args.outDir = argv[++i];
         } else if (arg == "--maxEntries" && i + 1 < argc) {
             args.maxEntries = std::stoll(argv[++i]);
+        } else if (arg == "--firstEntry" && i + 1 < argc) {
+            args.firstEntry = std::stoll(argv[++i]);
+        } else if (arg == "--lastEntry" && i + 1 < argc) {
+            args.lastEntry = std::stoll(argv[++i]);
+        } else if (arg == "--stride" && i + 1 < argc) {
+            args.stride = std::stoll(argv[++i]);
+        } else if (arg == "--fraction" && i + 1 < argc) {
+            args.fraction = std::stod(argv[++i]);
+        } else if (arg == "--fractionSeed" && i + 1 < argc) {
+            args.fractionSeed = std::stoull(argv[++i]);
+        } else if (arg == "--entryList" && i + 1 < argc) {
+            args.entryList = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            args.nThreads = std::stoi(argv[++i]);
         } else if (arg == "--outFilename" && i + 1 < argc) {
             args.outFilename = argv[++i];
         } else if (arg == "--targetPolarization" && i + 1 < argc) {
             args.targetPolarization = std::stod(argv[++i]);
         } else if (arg == "--n_injections" && i + 1 < argc) {
             args.n_injections = std::stoi(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            args.seed = std::stoull(argv[++i]);
         } else if (arg == "--grid" && i + 1 < argc) {
             // Convert comma separated list to vector
             std::string gridStr = argv[++i];
@@ -99,11 +162,67 @@ Args parseArgs(int argc, char** argv) {
             args.bin_index_start = std::stoi(argv[++i]);
         } else if (arg == "--bin_index_end" && i + 1 < argc) {
             args.bin_index_end = std::stoi(argv[++i]);
+        } else if (arg == "--bins" && i + 1 < argc) {
+            const std::string val = argv[++i];
+            if (val != "all") {
+                LOG_ERROR("--bins only accepts 'all' (use --bin_index_start/--bin_index_end for a range)");
+                exit(1);
+            }
+            args.all_bins = true;
         } else if (arg == "--extract_with_true" && i + 1 < argc) {
             std::string val = argv[++i];
+            args.extract_both = (val == "both" || val == "Both" || val == "BOTH");
             args.extract_with_true = (val == "1" || val == "true" || val == "True" || val == "TRUE" || val == "t" || val == "T" || val == "yes" || val == "Yes" || val == "YES");
         } else if (arg == "--A_opt" && i + 1 < argc) {
             args.A_opt = std::stod(argv[++i]);
+        } else if (arg == "--A_scan" && i + 1 < argc) {
+            args.A_scan = parseDoubleList(argv[++i]);
+        } else if (arg == "--pol_scan" && i + 1 < argc) {
+            args.polarization_scan = parseDoubleList(argv[++i]);
+        } else if (arg == "--asimov") {
+            args.asimov = true;
+        } else if (arg == "--modulations" && i + 1 < argc) {
+            std::stringstream ss(argv[++i]);
+            std::string name;
+            while (std::getline(ss, name, ',')) {
+                if (name.empty())
+                    continue;
+                if (!Modulation::parse(name)) {
+                    LOG_ERROR("Invalid modulation: " + name + " (expected collins, sivers or pretzelosity)");
+                    exit(1);
+                }
+                args.modulations.push_back(name);
+            }
+        } else if (arg == "--A_mod" && i + 1 < argc) {
+            args.A_modulations = parseDoubleList(argv[++i]);
+        } else if (arg == "--bootstrap") {
+            args.bootstrap = true;
+        } else if (arg == "--aggregate" && i + 1 < argc) {
+            args.aggregate = std::stod(argv[++i]);
+            // The sink holds about 2 / tol cells per dataset
+            if (args.aggregate != 0.0 && !(args.aggregate >= 1e-6 && args.aggregate <= 1.0)) {
+                LOG_ERROR("--aggregate tolerance must be 0 (off) or in [1e-6, 1]");
+                exit(1);
+            }
+        } else if (arg == "--binned" && i + 1 < argc) {
+            args.binned = std::stoi(argv[++i]);
+            // One cell has no analyzing-power lever arm to fit
+            if (args.binned != 0 && args.binned < 2) {
+                LOG_ERROR("--binned needs at least 2 cells (0: unbinned)");
+                exit(1);
+            }
+        } else if (arg == "--fast_toys" && i + 1 < argc) {
+            args.fast_toys = std::stoi(argv[++i]);
+        } else if (arg == "--toys" && i + 1 < argc) {
+            args.toys = argv[++i];
+        } else if (arg == "--crn") {
+            args.common_random_numbers = true;
+        } else if (arg == "--target_precision" && i + 1 < argc) {
+            args.target_precision = std::stod(argv[++i]);
+        } else if (arg == "--min_injections" && i + 1 < argc) {
+            args.min_injections = std::stoi(argv[++i]);
+        } else if (arg == "--max_injections" && i + 1 < argc) {
+            args.max_injections = std::stoi(argv[++i]);
         } else if (!arg.empty() && arg[0] != '-') {
             // treat as positional argument if not a flag
             if (args.filename.empty()) {
@@ -125,6 +244,25 @@ Args parseArgs(int argc, char** argv) {
         }
     }
 
+    // Extraction modes replace each other rather than combine (modulations, then binned, then aggregated fits take
+    // precedence, and bootstrap replicas always use the unbinned single-amplitude fit), so a combination is an error
+    const std::vector<std::pair<std::string, bool>> modes = {{"--modulations", !args.modulations.empty()},
+                                                             {"--binned", args.binned > 0},
+                                                             {"--aggregate", args.aggregate > 0.0},
+                                                             {"--bootstrap", args.bootstrap}};
+    for (size_t a = 0; a < modes.size(); ++a) {
+        for (size_t b = a + 1; b < modes.size(); ++b) {
+            if (modes[a].second && modes[b].second) {
+                LOG_ERROR(modes[a].first + " and " + modes[b].first + " cannot be combined");
+                exit(1);
+            }
+        }
+    }
+    if (args.asimov && args.bootstrap) {
+        LOG_ERROR("--asimov and --bootstrap cannot be combined");
+        exit(1);
+    }
+
     // Require filename, treename, and energyConfig
     if (args.filename.empty() || args.treename.empty() || args.energyConfig.empty()) {
         LOG_INFO("Missing required parameters. Use --help for usage.");
@@ -133,3 +271,30 @@ Args parseArgs(int argc, char** argv) {
 
     return args;
 }
+
+EventRange makeEventRange(const Args& args) {
+    EventRange range;
+    long long last = args.lastEntry;
+    if (args.maxEntries > 0)
+        last = last < 0 ? args.firstEntry + args.maxEntries : std::min(last, args.firstEntry + args.maxEntries);
+    range.setFirst(args.firstEntry).setLast(last);
+    try {
+        range.setStride(args.stride).setFraction(args.fraction, args.fractionSeed);
+    } catch (const std::invalid_argument& e) {
+        LOG_ERROR(e.what());
+        exit(1);
+    }
+    if (!args.entryList.empty()) {
+        std::ifstream in(args.entryList);
+        if (!in) {
+            LOG_ERROR("Could not open entry list " + args.entryList);
+            exit(1);
+        }
+        std::vector<Long64_t> entries;
+        Long64_t e;
+        while (in >> e)
+            entries.push_back(e);
+        range.setEntries(std::move(entries));
+    }
+    return range;
+}
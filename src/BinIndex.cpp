@@ -0,0 +1,293 @@
+#include "BinIndex.h"
+#include "Logger.h"
+#include "TFile.h"
+#include "TTree.h"
+#include "Utility.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace {
+
+// Table rows grouped by X interval so each event only tests the rows of its X slice
+class RowLocator {
+public:
+    explicit RowLocator(const std::vector<TableRow>& rows)
+        : rows(rows) {
+        for (size_t r = 0; r < rows.size(); ++r) {
+            auto it = std::find_if(slices.begin(), slices.end(), [&](const Slice& s) {
+                return s.xmin == rows[r].X_min && s.xmax == rows[r].X_max;
+            });
+            if (it == slices.end()) {
+                slices.push_back({rows[r].X_min, rows[r].X_max, {}});
+                it = slices.end() - 1;
+            }
+            it->rows.push_back(r);
+        }
+        std::sort(slices.begin(), slices.end(), [](const Slice& a, const Slice& b) { return a.xmin < b.xmin; });
+    }
+
+    // Calls f(row) for every row containing the point (rows share edges, so a point may hit several)
+    template <typename F>
+    void forEachRow(double X, double Q2, double Z, double PhPerp, F&& f) const {
+        auto it = std::upper_bound(slices.begin(), slices.end(), X, [](double x, const Slice& s) { return x < s.xmin; });
+        while (it != slices.begin()) {
+            --it;
+            if (it->xmax < X)
+                break;
+            for (size_t r : it->rows) {
+                const TableRow& row = rows[r];
+                if (Q2 >= row.Q_min * row.Q_min && Q2 <= row.Q_max * row.Q_max && Z >= row.Z_min && Z <= row.Z_max &&
+                    PhPerp >= row.PhPerp_min && PhPerp <= row.PhPerp_max)
+                    f(r);
+            }
+        }
+    }
+
+private:
+    struct Slice {
+        double xmin;
+        double xmax;
+        std::vector<size_t> rows;
+    };
+    const std::vector<TableRow>& rows;
+    std::vector<Slice> slices;
+};
+
+// Table row lying inside the bounds of a grid bin (up to rounding of the bounds)
+bool rowInBin(const TableRow& row, const Bin& bin) {
+    const double eps = 1e-9;
+    return row.X_min >= bin.getMin("X") - eps && row.X_max <= bin.getMax("X") + eps && row.Q_min >= bin.getMin("Q") - eps &&
+           row.Q_max <= bin.getMax("Q") + eps && row.Z_min >= bin.getMin("Z") - eps && row.Z_max <= bin.getMax("Z") + eps &&
+           row.PhPerp_min >= bin.getMin("PhPerp") - eps && row.PhPerp_max <= bin.getMax("PhPerp") + eps;
+}
+
+} // namespace
+
+unsigned long long BinIndex::boundsHash(const std::vector<TableRow>& rows) {
+    // FNV-1a over the row boundaries (AUT values do not affect the selection)
+    unsigned long long h = 1469598103934665603ULL;
+    auto mix = [&h](double v) {
+        const auto* p = reinterpret_cast<const unsigned char*>(&v);
+        for (size_t i = 0; i < sizeof(double); ++i) {
+            h ^= p[i];
+            h *= 1099511628211ULL;
+        }
+    };
+    for (const auto& row : rows) {
+        mix(row.X_min);
+        mix(row.X_max);
+        mix(row.Q_min);
+        mix(row.Q_max);
+        mix(row.Z_min);
+        mix(row.Z_max);
+        mix(row.PhPerp_min);
+        mix(row.PhPerp_max);
+    }
+    return h;
+}
+
+void BinIndex::build(EventSource& source, const Table& table, const EventRange& range, int nThreads) {
+    rows = table.getRows();
+    reco.assign(rows.size(), EntryBitmap());
+    truth.assign(rows.size(), EntryBitmap());
+
+    RowLocator locator(rows);
+    nEntries = source.getEntries();
+    const Long64_t expected = static_cast<Long64_t>(std::ceil(range.count(nEntries)));
+    util::ProgressBar pbar(static_cast<size_t>(expected), 60, "Indexing");
+
+    // Indexes the entries of src, which start at global entry `offset`
+    auto indexRange = [&](EventSource& src, Long64_t offset, Long64_t n, std::vector<EntryBitmap>& r, std::vector<EntryBitmap>& t,
+                          const std::function<void(Long64_t)>& progress) {
+        Long64_t processed = 0;
+        range.forEach(offset, offset + n, [&](Long64_t i) {
+            const Event& ev = src.getEntry(i - offset);
+            const uint64_t entry = static_cast<uint64_t>(i);
+            locator.forEachRow(ev.X, ev.Q2, ev.Z, ev.PhPerp, [&](size_t row) { r[row].add(entry); });
+            locator.forEachRow(ev.TrueX, ev.TrueQ2, ev.TrueZ, ev.TruePhPerp, [&](size_t row) { t[row].add(entry); });
+            if ((++processed & 0x3FF) == 0)
+                progress(processed);
+        });
+    };
+
+    const size_t nParts = source.getNumParts();
+    std::vector<std::unique_ptr<EventSource>> partSources;
+    if (nThreads > 1 && nParts > 1) {
+        for (size_t p = 0; p < nParts; ++p) {
+            partSources.push_back(source.openPart(p));
+            if (!partSources.back()) {
+                partSources.clear();
+                break;
+            }
+        }
+    }
+
+    if (partSources.empty()) {
+        indexRange(source, 0, nEntries, reco, truth, [&](Long64_t n) { pbar.update(static_cast<size_t>(n)); });
+    } else {
+        // One bitmap set per file; files cover disjoint, increasing entry ranges so merging in order stays cheap
+        std::vector<std::vector<EntryBitmap>> partReco(partSources.size(), std::vector<EntryBitmap>(rows.size()));
+        std::vector<std::vector<EntryBitmap>> partTruth(partSources.size(), std::vector<EntryBitmap>(rows.size()));
+        std::mutex pbarMutex;
+        std::atomic<Long64_t> done{0};
+        util::parallelFor(partSources.size(), nThreads, [&](size_t p) {
+            indexRange(*partSources[p], source.getPartOffset(p), source.getPartEntries(p), partReco[p], partTruth[p], [&](Long64_t) {
+                const Long64_t n = (done += 0x400);
+                std::lock_guard<std::mutex> lock(pbarMutex);
+                pbar.update(static_cast<size_t>(std::min(n, expected)));
+            });
+        });
+        for (size_t p = 0; p < partSources.size(); ++p) {
+            for (size_t r = 0; r < rows.size(); ++r) {
+                reco[r] |= partReco[p][r];
+                truth[r] |= partTruth[p][r];
+            }
+        }
+    }
+    pbar.finish();
+    LOG_INFO("BinIndex: indexed " + std::to_string(nEntries) + " entries into " + std::to_string(rows.size()) + " table rows.");
+}
+
+bool BinIndex::save(const std::string& cacheFile) const {
+    std::unique_ptr<TFile> f(TFile::Open(cacheFile.c_str(), "RECREATE"));
+    if (!f || f->IsZombie()) {
+        LOG_ERROR("Failed to create bin index file: " + cacheFile);
+        return false;
+    }
+    TTree meta("binIndexMeta", "Bin index metadata");
+    Long64_t entries = nEntries;
+    int nRows = static_cast<int>(rows.size());
+    ULong64_t hash = boundsHash(rows);
+    meta.Branch("nEntries", &entries, "nEntries/L");
+    meta.Branch("nRows", &nRows, "nRows/I");
+    meta.Branch("boundsHash", &hash, "boundsHash/l");
+    meta.Fill();
+
+    TTree t("binIndex", "Per-row reco/true entry bitmaps");
+    int row = 0;
+    std::vector<unsigned char> recoBytes, trueBytes;
+    std::vector<unsigned char>* recoPtr = &recoBytes;
+    std::vector<unsigned char>* truePtr = &trueBytes;
+    t.Branch("row", &row, "row/I");
+    t.Branch("reco", &recoPtr);
+    t.Branch("truth", &truePtr);
+    for (size_t r = 0; r < rows.size(); ++r) {
+        row = static_cast<int>(r);
+        recoBytes = reco[r].serialize();
+        trueBytes = truth[r].serialize();
+        t.Fill();
+    }
+    f->cd();
+    meta.Write();
+    t.Write();
+    f->Close();
+    LOG_INFO("Saved bin index: " + cacheFile);
+    return true;
+}
+
+bool BinIndex::load(const std::string& cacheFile, const Table& table, Long64_t expectedEntries) {
+    std::unique_ptr<TFile> f(TFile::Open(cacheFile.c_str(), "READ"));
+    if (!f || f->IsZombie())
+        return false;
+    TTree* meta = dynamic_cast<TTree*>(f->Get("binIndexMeta"));
+    TTree* t = dynamic_cast<TTree*>(f->Get("binIndex"));
+    if (!meta || !t || meta->GetEntries() != 1)
+        return false;
+
+    Long64_t entries = 0;
+    int nRows = 0;
+    ULong64_t hash = 0;
+    meta->SetBranchAddress("nEntries", &entries);
+    meta->SetBranchAddress("nRows", &nRows);
+    meta->SetBranchAddress("boundsHash", &hash);
+    meta->GetEntry(0);
+    const auto& tableRows = table.getRows();
+    if (entries != expectedEntries || nRows != static_cast<int>(tableRows.size()) || hash != boundsHash(tableRows)) {
+        LOG_WARN("BinIndex: cache " + cacheFile + " does not match the current tree/table; rebuilding.");
+        return false;
+    }
+
+    int row = 0;
+    std::vector<unsigned char>* recoPtr = nullptr;
+    std::vector<unsigned char>* truePtr = nullptr;
+    t->SetBranchAddress("row", &row);
+    t->SetBranchAddress("reco", &recoPtr);
+    t->SetBranchAddress("truth", &truePtr);
+    rows = tableRows;
+    reco.assign(rows.size(), EntryBitmap());
+    truth.assign(rows.size(), EntryBitmap());
+    for (Long64_t i = 0; i < t->GetEntries(); ++i) {
+        t->GetEntry(i);
+        if (row < 0 || row >= nRows || !recoPtr || !truePtr)
+            return false;
+        reco[row] = EntryBitmap::deserialize(*recoPtr);
+        truth[row] = EntryBitmap::deserialize(*truePtr);
+    }
+    nEntries = entries;
+    LOG_INFO("Loaded bin index from: " + cacheFile);
+    return true;
+}
+
+EntryBitmap BinIndex::select(const Bin& bin, bool useTrue) const {
+    std::vector<const EntryBitmap*> parts;
+    for (size_t r = 0; r < rows.size(); ++r)
+        if (rowInBin(rows[r], bin))
+            parts.push_back(&rowBitmap(r, useTrue));
+    return EntryBitmap::unite(parts);
+}
+
+bool BinIndex::covers(const Bin& bin) const {
+    std::vector<const TableRow*> inside;
+    for (const auto& row : rows)
+        if (rowInBin(row, bin))
+            inside.push_back(&row);
+    if (inside.empty())
+        return false;
+
+    // The row edges cut the bin into elementary cells; the rows cover the bin if every cell is inside one of them
+    const char* vars[4] = {"X", "Q", "Z", "PhPerp"};
+    auto rowMin = [](const TableRow& r, int a) { return a == 0 ? r.X_min : a == 1 ? r.Q_min : a == 2 ? r.Z_min : r.PhPerp_min; };
+    auto rowMax = [](const TableRow& r, int a) { return a == 0 ? r.X_max : a == 1 ? r.Q_max : a == 2 ? r.Z_max : r.PhPerp_max; };
+    std::vector<double> centers[4];
+    size_t nCells = 1;
+    for (int a = 0; a < 4; ++a) {
+        const double lo = bin.getMin(vars[a]), hi = bin.getMax(vars[a]);
+        std::vector<double> edges = {lo, hi};
+        for (const TableRow* r : inside)
+            for (double e : {rowMin(*r, a), rowMax(*r, a)})
+                if (e > lo && e < hi)
+                    edges.push_back(e);
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+        if (edges.size() == 1)
+            centers[a].push_back(edges[0]);
+        for (size_t k = 0; k + 1 < edges.size(); ++k)
+            centers[a].push_back(0.5 * (edges[k] + edges[k + 1]));
+        nCells *= centers[a].size();
+    }
+    // Rows with unaligned edges would make too many cells to check; treat them as not covering
+    if (nCells > 1000000)
+        return false;
+
+    for (size_t cell = 0; cell < nCells; ++cell) {
+        double point[4];
+        size_t rest = cell;
+        for (int a = 0; a < 4; ++a) {
+            point[a] = centers[a][rest % centers[a].size()];
+            rest /= centers[a].size();
+        }
+        const bool covered = std::any_of(inside.begin(), inside.end(), [&](const TableRow* r) {
+            for (int a = 0; a < 4; ++a)
+                if (point[a] < rowMin(*r, a) || point[a] > rowMax(*r, a))
+                    return false;
+            return true;
+        });
+        if (!covered)
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,180 @@
+#include "EntryBitmap.h"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+void EntryBitmap::Container::add(uint16_t low) {
+    if (isBitset()) {
+        uint64_t& word = bits[low >> 6];
+        const uint64_t mask = uint64_t(1) << (low & 63);
+        if (!(word & mask)) {
+            word |= mask;
+            ++card;
+        }
+        return;
+    }
+    // Fast path for in-order filling
+    if (array.empty() || array.back() < low) {
+        array.push_back(low);
+    } else {
+        auto it = std::lower_bound(array.begin(), array.end(), low);
+        if (it != array.end() && *it == low)
+            return;
+        array.insert(it, low);
+    }
+    ++card;
+    if (card > kArrayMax)
+        toBitset();
+}
+
+bool EntryBitmap::Container::contains(uint16_t low) const {
+    if (isBitset())
+        return (bits[low >> 6] >> (low & 63)) & 1;
+    return std::binary_search(array.begin(), array.end(), low);
+}
+
+void EntryBitmap::Container::toBitset() {
+    bits.assign(kBitsetWords, 0);
+    for (uint16_t low : array)
+        bits[low >> 6] |= uint64_t(1) << (low & 63);
+    array.clear();
+    array.shrink_to_fit();
+}
+
+void EntryBitmap::Container::unite(const Container& other) {
+    if (!isBitset() && !other.isBitset() && card + other.card <= kArrayMax) {
+        std::vector<uint16_t> merged;
+        merged.reserve(card + other.card);
+        std::set_union(array.begin(), array.end(), other.array.begin(), other.array.end(), std::back_inserter(merged));
+        array.swap(merged);
+        card = static_cast<uint32_t>(array.size());
+        return;
+    }
+    if (!isBitset())
+        toBitset();
+    if (other.isBitset()) {
+        for (size_t w = 0; w < kBitsetWords; ++w)
+            bits[w] |= other.bits[w];
+    } else {
+        for (uint16_t low : other.array)
+            bits[low >> 6] |= uint64_t(1) << (low & 63);
+    }
+    card = 0;
+    for (uint64_t word : bits)
+        card += static_cast<uint32_t>(__builtin_popcountll(word));
+}
+
+EntryBitmap::Container& EntryBitmap::containerFor(uint64_t key) {
+    if (containers.empty() || containers.back().key < key) {
+        containers.emplace_back();
+        containers.back().key = key;
+        return containers.back();
+    }
+    auto it = std::lower_bound(containers.begin(), containers.end(), key,
+                               [](const Container& c, uint64_t k) { return c.key < k; });
+    if (it == containers.end() || it->key != key) {
+        it = containers.insert(it, Container{});
+        it->key = key;
+    }
+    return *it;
+}
+
+void EntryBitmap::add(uint64_t entry) {
+    containerFor(entry >> 16).add(static_cast<uint16_t>(entry & 0xFFFF));
+}
+
+bool EntryBitmap::contains(uint64_t entry) const {
+    const uint64_t key = entry >> 16;
+    auto it = std::lower_bound(containers.begin(), containers.end(), key,
+                               [](const Container& c, uint64_t k) { return c.key < k; });
+    return it != containers.end() && it->key == key && it->contains(static_cast<uint16_t>(entry & 0xFFFF));
+}
+
+uint64_t EntryBitmap::cardinality() const {
+    uint64_t n = 0;
+    for (const auto& c : containers)
+        n += c.card;
+    return n;
+}
+
+EntryBitmap& EntryBitmap::operator|=(const EntryBitmap& other) {
+    for (const auto& oc : other.containers) {
+        Container& c = containerFor(oc.key);
+        if (c.card == 0 && !c.isBitset())
+            c = oc;
+        else
+            c.unite(oc);
+    }
+    return *this;
+}
+
+EntryBitmap EntryBitmap::unite(const std::vector<const EntryBitmap*>& bitmaps) {
+    EntryBitmap result;
+    for (const EntryBitmap* b : bitmaps) {
+        if (b)
+            result |= *b;
+    }
+    return result;
+}
+
+namespace {
+template <typename T>
+void putRaw(std::vector<unsigned char>& out, const T& v) {
+    const auto* p = reinterpret_cast<const unsigned char*>(&v);
+    out.insert(out.end(), p, p + sizeof(T));
+}
+
+template <typename T>
+T getRaw(const std::vector<unsigned char>& in, size_t& pos) {
+    if (pos + sizeof(T) > in.size())
+        throw std::runtime_error("EntryBitmap::deserialize: truncated buffer");
+    T v;
+    std::memcpy(&v, in.data() + pos, sizeof(T));
+    pos += sizeof(T);
+    return v;
+}
+} // namespace
+
+// Layout: [u32 nContainers] then per container [u64 key][u32 card][u8 isBitset][payload]
+std::vector<unsigned char> EntryBitmap::serialize() const {
+    std::vector<unsigned char> out;
+    putRaw(out, static_cast<uint32_t>(containers.size()));
+    for (const auto& c : containers) {
+        putRaw(out, c.key);
+        putRaw(out, c.card);
+        putRaw(out, static_cast<uint8_t>(c.isBitset()));
+        if (c.isBitset()) {
+            for (uint64_t word : c.bits)
+                putRaw(out, word);
+        } else {
+            for (uint16_t low : c.array)
+                putRaw(out, low);
+        }
+    }
+    return out;
+}
+
+EntryBitmap EntryBitmap::deserialize(const std::vector<unsigned char>& bytes) {
+    EntryBitmap bm;
+    if (bytes.empty())
+        return bm;
+    size_t pos = 0;
+    const uint32_t n = getRaw<uint32_t>(bytes, pos);
+    bm.containers.resize(n);
+    for (auto& c : bm.containers) {
+        c.key = getRaw<uint64_t>(bytes, pos);
+        c.card = getRaw<uint32_t>(bytes, pos);
+        const bool isBitset = getRaw<uint8_t>(bytes, pos) != 0;
+        if (isBitset) {
+            c.bits.resize(kBitsetWords);
+            for (auto& word : c.bits)
+                word = getRaw<uint64_t>(bytes, pos);
+        } else {
+            c.array.resize(c.card);
+            for (auto& low : c.array)
+                low = getRaw<uint16_t>(bytes, pos);
+        }
+    }
+    return bm;
+}
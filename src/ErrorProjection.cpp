@@ -0,0 +1,519 @@
+#include "ErrorProjection.h"
+#include "Kinematics.h"
+#include "Logger.h"
+#include "Reduction.h"
+#include "TFile.h"
+#include "TTree.h"
+#include "Utility.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <yaml-cpp/yaml.h>
+
+namespace {
+
+// Grid bins grouped by X interval so each event only tests the bins of its X slice (same inclusive cuts as Inject)
+class BinLocator {
+public:
+    explicit BinLocator(const std::vector<Bin>& bins) {
+        for (size_t b = 0; b < bins.size(); ++b) {
+            const Bin& bin = bins[b];
+            bounds.push_back({bin.getMin("Q") * bin.getMin("Q"), bin.getMax("Q") * bin.getMax("Q"), bin.getMin("Z"), bin.getMax("Z"),
+                              bin.getMin("PhPerp"), bin.getMax("PhPerp")});
+            const double xmin = bin.getMin("X"), xmax = bin.getMax("X");
+            auto it = std::find_if(slices.begin(), slices.end(), [&](const Slice& s) { return s.xmin == xmin && s.xmax == xmax; });
+            if (it == slices.end()) {
+                slices.push_back({xmin, xmax, {}});
+                it = slices.end() - 1;
+            }
+            it->bins.push_back(b);
+        }
+        std::sort(slices.begin(), slices.end(), [](const Slice& a, const Slice& b) { return a.xmin < b.xmin; });
+    }
+
+    // Calls f(bin) for every bin containing the point (bins share edges, so a point may hit several)
+    template <typename F>
+    void forEachBin(double X, double Q2, double Z, double PhPerp, F&& f) const {
+        auto it = std::upper_bound(slices.begin(), slices.end(), X, [](double x, const Slice& s) { return x < s.xmin; });
+        while (it != slices.begin()) {
+            --it;
+            if (it->xmax < X)
+                break;
+            for (size_t b : it->bins) {
+                const Bounds& c = bounds[b];
+                if (Q2 >= c.q2Min && Q2 <= c.q2Max && Z >= c.zMin && Z <= c.zMax && PhPerp >= c.phPerpMin && PhPerp <= c.phPerpMax)
+                    f(b);
+            }
+        }
+    }
+
+private:
+    struct Slice {
+        double xmin;
+        double xmax;
+        std::vector<size_t> bins;
+    };
+    struct Bounds {
+        double q2Min, q2Max, zMin, zMax, phPerpMin, phPerpMax;
+    };
+    std::vector<Bounds> bounds;
+    std::vector<Slice> slices;
+};
+
+// Events of one kinematics (reco or true) waiting for a vectorized S_T/Depol/sin evaluation
+struct PendingBatch {
+    KinematicsBatch kin;
+    std::vector<double> weights;
+    std::vector<std::pair<size_t, size_t>> hits; // (event in batch, bin)
+};
+
+constexpr size_t kBatchSize = 4096;
+
+// BinSums of one bin while the pass runs, with compensated sums (see Reduction.h)
+struct BinAccumulator {
+    Long64_t events = 0;
+    CompensatedSum sumW, sumW2, expected, fisher, sumWg2;
+    void merge(const BinAccumulator& o) {
+        events += o.events;
+        sumW.merge(o.sumW);
+        sumW2.merge(o.sumW2);
+        expected.merge(o.expected);
+        fisher.merge(o.fisher);
+        sumWg2.merge(o.sumWg2);
+    }
+    ErrorProjection::BinSums sums() const {
+        ErrorProjection::BinSums s;
+        s.events = events;
+        s.sumW = sumW.value();
+        s.sumW2 = sumW2.value();
+        s.expected = expected.value();
+        s.fisher = fisher.value();
+        s.sumWg2 = sumWg2.value();
+        return s;
+    }
+};
+
+} // namespace
+
+double ErrorProjection::BinSums::sigma() const {
+    return fisher > 0.0 ? 1.0 / std::sqrt(fisher) : 0.0;
+}
+
+double ErrorProjection::BinSums::nEffMC() const {
+    return sumW2 > 0.0 ? sumW * sumW / sumW2 : 0.0;
+}
+
+ErrorProjection::ErrorProjection(EventSource* source, const Grid* grid, double scale, double targetPolarization)
+    : source(source)
+    , grid(grid)
+    , scale(scale)
+    , targetPolarization(targetPolarization) {}
+
+void ErrorProjection::run() {
+    const size_t nBins = grid->getBins().size();
+    reco.assign(nBins, BinSums());
+    truth.assign(nBins, BinSums());
+    recoDensity.clear();
+    trueDensity.clear();
+    recoFast.clear();
+    trueFast.clear();
+    densityFromCache = false;
+    if (fastToys > 0) {
+        ToyDensity empty;
+        empty.reset(densityPhiCells, densityAnalyzingCells);
+        recoDensity.assign(nBins, empty);
+        trueDensity.assign(nBins, empty);
+    }
+
+    if (fastToys > 0 && !densityCacheFile.empty() && loadDensities(densityCacheFile)) {
+        densityFromCache = true;
+        fillFromDensities();
+    } else {
+        fillFromEvents();
+        if (fastToys > 0 && !densityCacheFile.empty())
+            saveDensities(densityCacheFile);
+    }
+    if (fastToys <= 0)
+        return;
+
+    // Spin toys of every bin and dataset from the densities, on independent streams
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t b = 0; b < nBins; ++b) {
+        recoFast.push_back(runFastToys(recoDensity[b], amplitude, targetPolarization, scale, fastToys, seed, static_cast<uint32_t>(2 * b)));
+        trueFast.push_back(
+            runFastToys(trueDensity[b], amplitude, targetPolarization, scale, fastToys, seed, static_cast<uint32_t>(2 * b + 1)));
+    }
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    LOG_INFO("ErrorProjection: " + std::to_string(fastToys) + " fast toys per bin and dataset for " + std::to_string(nBins) +
+             " bins in " + std::to_string(ms) + " ms.");
+}
+
+void ErrorProjection::fillFromDensities() {
+    // Counts and weights are exact; the information uses the mean g^2 of each cell
+    const double P = targetPolarization;
+    const double A = amplitude;
+    auto fill = [&](const ToyDensity& d, BinSums& out) {
+        BinAccumulator s;
+        for (const auto& c : d.cells) {
+            if (c.events == 0)
+                continue;
+            const double g2 = c.sumW > 0 ? c.sumWG2 / c.sumW : 0.0;
+            s.events += c.events;
+            s.sumW += c.sumW;
+            s.sumW2 += c.sumW2;
+            s.expected += c.sumW * scale;
+            s.fisher += c.sumW * scale * P * P * g2 / std::max(1e-6, 1.0 - A * A * P * P * g2);
+            s.sumWg2 += c.sumWG2 * scale;
+        }
+        out = s.sums();
+    };
+    for (size_t b = 0; b < reco.size(); ++b) {
+        fill(recoDensity[b], reco[b]);
+        fill(trueDensity[b], truth[b]);
+    }
+    LOG_INFO("ErrorProjection: projected " + std::to_string(reco.size()) + " bins from the cached densities " + densityCacheFile);
+}
+
+void ErrorProjection::fillFromEvents() {
+    std::vector<Bin> bins;
+    for (const auto& kv : grid->getBins())
+        bins.push_back(kv.second);
+    const BinLocator locator(bins);
+    const double P = targetPolarization;
+    const double A = amplitude;
+    const bool withDensity = fastToys > 0;
+
+    auto flush = [&](PendingBatch& pending, std::vector<BinAccumulator>& sums, std::vector<ToyDensity>& densities) {
+        pending.kin.compute();
+        const KinematicsBatch& k = pending.kin;
+        for (const auto& [e, b] : pending.hits) {
+            BinAccumulator& s = sums[b];
+            const double w = pending.weights[e];
+            if (withDensity)
+                densities[b].fill(k.PhiH[e] + k.PhiS[e], k.S_T[e] * k.Depol[e], w);
+            const double W = w * scale;
+            double g = k.S_T[e] * k.Depol[e] * k.SinPhi[e];
+            if (!std::isfinite(g))
+                g = 0.0;
+            const double Pg = P * g;
+            ++s.events;
+            s.sumW += w;
+            s.sumW2 += w * w;
+            s.expected += W;
+            s.fisher += W * Pg * Pg / std::max(1e-6, 1.0 - A * A * Pg * Pg);
+            s.sumWg2 += W * g * g;
+        }
+        pending = PendingBatch();
+    };
+
+    const Long64_t nEntries = source->getEntries();
+    const Long64_t expected = static_cast<Long64_t>(std::ceil(range.count(nEntries)));
+    util::ProgressBar pbar(static_cast<size_t>(expected), 60, "Projecting");
+
+    // Projects the global entries [begin, end) read from src, whose first entry is global entry `offset`
+    auto projectRange = [&](EventSource& src, Long64_t offset, Long64_t begin, Long64_t end, std::vector<BinAccumulator>& r,
+                            std::vector<BinAccumulator>& t, std::vector<ToyDensity>& rd, std::vector<ToyDensity>& td,
+                            const std::function<void(Long64_t)>& progress) {
+        PendingBatch pendingReco, pendingTrue;
+        Long64_t processed = 0;
+        range.forEach(begin, end, [&](Long64_t i) {
+            const Event& ev = src.getEntry(i - offset);
+            const size_t nReco = pendingReco.hits.size();
+            locator.forEachBin(ev.X, ev.Q2, ev.Z, ev.PhPerp, [&](size_t b) { pendingReco.hits.push_back({pendingReco.kin.size(), b}); });
+            if (pendingReco.hits.size() > nReco) {
+                pendingReco.kin.push(ev.X, ev.Q2, ev.Y, ev.PhiH, ev.PhiS);
+                pendingReco.weights.push_back(ev.Weight);
+            }
+            const size_t nTrue = pendingTrue.hits.size();
+            locator.forEachBin(ev.TrueX, ev.TrueQ2, ev.TrueZ, ev.TruePhPerp,
+                               [&](size_t b) { pendingTrue.hits.push_back({pendingTrue.kin.size(), b}); });
+            if (pendingTrue.hits.size() > nTrue) {
+                pendingTrue.kin.push(ev.TrueX, ev.TrueQ2, ev.TrueY, ev.TruePhiH, ev.TruePhiS);
+                pendingTrue.weights.push_back(ev.Weight);
+            }
+            if (pendingReco.kin.size() >= kBatchSize)
+                flush(pendingReco, r, rd);
+            if (pendingTrue.kin.size() >= kBatchSize)
+                flush(pendingTrue, t, td);
+            if ((++processed & 0x3FF) == 0)
+                progress(processed);
+        });
+        flush(pendingReco, r, rd);
+        flush(pendingTrue, t, td);
+    };
+
+    const size_t nParts = source->getNumParts();
+    std::vector<std::unique_ptr<EventSource>> partSources;
+    if (nThreads > 1 && nParts > 1) {
+        for (size_t p = 0; p < nParts; ++p) {
+            partSources.push_back(source->openPart(p));
+            if (!partSources.back()) {
+                partSources.clear();
+                break;
+            }
+        }
+    }
+
+    // Sums of every file merged in file order: the reduction tree is fixed by the input files, so the result is
+    // bit-identical on any number of threads. Without private readers the files are projected one after the other.
+    std::vector<BinAccumulator> totalReco(bins.size()), totalTruth(bins.size());
+    std::mutex pbarMutex;
+    std::atomic<Long64_t> done{0};
+    auto progress = [&](Long64_t) {
+        const Long64_t n = (done += 0x400);
+        std::lock_guard<std::mutex> lock(pbarMutex);
+        pbar.update(static_cast<size_t>(std::min(n, expected)));
+    };
+    auto mergePart = [&](const std::vector<BinAccumulator>& r, const std::vector<BinAccumulator>& t, const std::vector<ToyDensity>& rd,
+                         const std::vector<ToyDensity>& td) {
+        for (size_t b = 0; b < bins.size(); ++b) {
+            totalReco[b].merge(r[b]);
+            totalTruth[b].merge(t[b]);
+            if (withDensity) {
+                recoDensity[b].merge(rd[b]);
+                trueDensity[b].merge(td[b]);
+            }
+        }
+    };
+    if (partSources.empty()) {
+        const std::vector<ToyDensity> emptyReco = recoDensity, emptyTrue = trueDensity;
+        for (size_t p = 0; p < nParts; ++p) {
+            std::vector<BinAccumulator> partReco(bins.size()), partTruth(bins.size());
+            std::vector<ToyDensity> partRecoDensity = emptyReco, partTrueDensity = emptyTrue;
+            const Long64_t offset = source->getPartOffset(p);
+            projectRange(*source, 0, offset, offset + source->getPartEntries(p), partReco, partTruth, partRecoDensity, partTrueDensity,
+                         progress);
+            mergePart(partReco, partTruth, partRecoDensity, partTrueDensity);
+        }
+    } else {
+        std::vector<std::vector<BinAccumulator>> partReco(partSources.size(), std::vector<BinAccumulator>(bins.size()));
+        std::vector<std::vector<BinAccumulator>> partTruth(partSources.size(), std::vector<BinAccumulator>(bins.size()));
+        std::vector<std::vector<ToyDensity>> partRecoDensity(partSources.size(), recoDensity);
+        std::vector<std::vector<ToyDensity>> partTrueDensity(partSources.size(), trueDensity);
+        util::parallelFor(partSources.size(), nThreads, [&](size_t p) {
+            const Long64_t offset = source->getPartOffset(p);
+            projectRange(*partSources[p], offset, offset, offset + source->getPartEntries(p), partReco[p], partTruth[p],
+                         partRecoDensity[p], partTrueDensity[p], progress);
+        });
+        for (size_t p = 0; p < partSources.size(); ++p)
+            mergePart(partReco[p], partTruth[p], partRecoDensity[p], partTrueDensity[p]);
+    }
+    for (size_t b = 0; b < bins.size(); ++b) {
+        reco[b] = totalReco[b].sums();
+        truth[b] = totalTruth[b].sums();
+    }
+    pbar.finish();
+    LOG_INFO("ErrorProjection: projected " + std::to_string(bins.size()) + " bins from one pass over " + std::to_string(nEntries) +
+             " entries.");
+}
+
+unsigned long long ErrorProjection::densityKey() const {
+    std::ostringstream key;
+    key << std::setprecision(17) << "files=";
+    for (const auto& file : inputFiles)
+        key << file << ",";
+    key << ";tree=" << source->getName() << ";entries=" << source->getEntries() << ";range=" << range.tag() << ";cells=" << densityPhiCells << "x"
+        << densityAnalyzingCells << ";bins=";
+    for (const auto& kv : grid->getBins())
+        for (const char* var : {"X", "Q", "Z", "PhPerp"})
+            key << kv.second.getMin(var) << ":" << kv.second.getMax(var) << ",";
+    return std::hash<std::string>{}(key.str());
+}
+
+bool ErrorProjection::saveDensities(const std::string& path) const {
+    std::unique_ptr<TFile> f(TFile::Open(path.c_str(), "RECREATE"));
+    if (!f || f->IsZombie()) {
+        LOG_ERROR("ErrorProjection: could not create density cache " + path);
+        return false;
+    }
+    TTree meta("toyDensityMeta", "Toy density metadata");
+    ULong64_t key = densityKey();
+    meta.Branch("key", &key, "key/l");
+    meta.Fill();
+
+    // Occupied cells only
+    TTree t("toyDensity", "Per-bin (PhiH + PhiS, S_T Depol) cells");
+    Int_t bin = 0, dataset = 0, cell = 0;
+    Long64_t events = 0;
+    double sumW = 0.0, sumW2 = 0.0, sumG = 0.0, sumWG2 = 0.0;
+    t.Branch("bin", &bin, "bin/I");
+    t.Branch("dataset", &dataset, "dataset/I");
+    t.Branch("cell", &cell, "cell/I");
+    t.Branch("events", &events, "events/L");
+    t.Branch("sumW", &sumW, "sumW/D");
+    t.Branch("sumW2", &sumW2, "sumW2/D");
+    t.Branch("sumG", &sumG, "sumG/D");
+    t.Branch("sumWG2", &sumWG2, "sumWG2/D");
+    for (dataset = 0; dataset < 2; ++dataset) {
+        const std::vector<ToyDensity>& densities = dataset ? trueDensity : recoDensity;
+        for (bin = 0; bin < static_cast<Int_t>(densities.size()); ++bin) {
+            for (cell = 0; cell < static_cast<Int_t>(densities[bin].cells.size()); ++cell) {
+                const ToyDensity::Cell& c = densities[bin].cells[cell];
+                if (c.events == 0)
+                    continue;
+                events = c.events;
+                sumW = c.sumW;
+                sumW2 = c.sumW2;
+                sumG = c.sumG;
+                sumWG2 = c.sumWG2;
+                t.Fill();
+            }
+        }
+    }
+    f->cd();
+    meta.Write();
+    t.Write();
+    f->Close();
+    LOG_INFO("ErrorProjection: saved toy densities to " + path);
+    return true;
+}
+
+bool ErrorProjection::loadDensities(const std::string& path) {
+    std::unique_ptr<TFile> f(TFile::Open(path.c_str(), "READ"));
+    if (!f || f->IsZombie())
+        return false;
+    TTree* meta = dynamic_cast<TTree*>(f->Get("toyDensityMeta"));
+    TTree* t = dynamic_cast<TTree*>(f->Get("toyDensity"));
+    if (!meta || !t || meta->GetEntries() != 1)
+        return false;
+    ULong64_t key = 0;
+    meta->SetBranchAddress("key", &key);
+    meta->GetEntry(0);
+    if (key != densityKey()) {
+        LOG_WARN("ErrorProjection: density cache " + path + " was built for another input, range, grid or cells; ignoring it.");
+        return false;
+    }
+    Int_t bin = 0, dataset = 0, cell = 0;
+    Long64_t events = 0;
+    double sumW = 0.0, sumW2 = 0.0, sumG = 0.0, sumWG2 = 0.0;
+    t->SetBranchAddress("bin", &bin);
+    t->SetBranchAddress("dataset", &dataset);
+    t->SetBranchAddress("cell", &cell);
+    t->SetBranchAddress("events", &events);
+    t->SetBranchAddress("sumW", &sumW);
+    t->SetBranchAddress("sumW2", &sumW2);
+    t->SetBranchAddress("sumG", &sumG);
+    t->SetBranchAddress("sumWG2", &sumWG2);
+    for (Long64_t i = 0; i < t->GetEntries(); ++i) {
+        t->GetEntry(i);
+        std::vector<ToyDensity>& densities = dataset ? trueDensity : recoDensity;
+        if (bin < 0 || bin >= static_cast<Int_t>(densities.size()) || cell < 0 || cell >= static_cast<Int_t>(densities[bin].cells.size()))
+            return false;
+        densities[bin].cells[cell] = ToyDensity::Cell{events, sumW, sumW2, sumG, sumWG2};
+    }
+    LOG_INFO("ErrorProjection: loaded toy densities from " + path);
+    return true;
+}
+
+bool ErrorProjection::writeYaml(const std::string& path, const std::string& toyYaml) const {
+    // Mean toy error and spread of the extracted values per (bin_index, reco/true) from an inject summary
+    struct ToyStats {
+        double meanError = 0.0;
+        double stddevExtracted = 0.0;
+    };
+    std::map<std::pair<int, bool>, ToyStats> toyErrors;
+    if (!toyYaml.empty()) {
+        try {
+            const YAML::Node toys = YAML::LoadFile(toyYaml);
+            auto meanError = [](const YAML::Node& node) {
+                const auto errs = node["all_errors"].as<std::vector<double>>();
+                double sum = 0.0;
+                for (double e : errs)
+                    sum += e;
+                return ToyStats{errs.empty() ? 0.0 : sum / errs.size(),
+                                node["stddev_extracted"] ? node["stddev_extracted"].as<double>() : 0.0};
+            };
+            for (const auto& job : toys["jobs"]) {
+                const int bin = job["bin_index"].as<int>();
+                if (job["all_errors"])
+                    toyErrors[{bin, !job["used_reconstructed_kinematics"].as<bool>()}] = meanError(job);
+                if (job["reco"] && job["reco"]["all_errors"])
+                    toyErrors[{bin, false}] = meanError(job["reco"]);
+                if (job["true"] && job["true"]["all_errors"])
+                    toyErrors[{bin, true}] = meanError(job["true"]);
+            }
+        } catch (const std::exception& e) {
+            LOG_ERROR("ErrorProjection: could not read toy summary " + toyYaml + ": " + e.what());
+            return false;
+        }
+    }
+
+    YAML::Emitter out;
+    out << YAML::BeginMap;
+    out << YAML::Key << "target_polarization" << YAML::Value << targetPolarization;
+    out << YAML::Key << "amplitude" << YAML::Value << amplitude;
+    out << YAML::Key << "scale" << YAML::Value << scale;
+    if (fastToys > 0) {
+        out << YAML::Key << "density_cells" << YAML::Value << YAML::Flow << std::vector<int>{densityPhiCells, densityAnalyzingCells};
+        out << YAML::Key << "density_from_cache" << YAML::Value << densityFromCache;
+        out << YAML::Key << "seed" << YAML::Value << seed;
+    }
+    out << YAML::Key << "bins" << YAML::Value << YAML::BeginSeq;
+    int binIndex = 0;
+    for (const auto& kv : grid->getBins()) {
+        const Bin& bin = kv.second;
+        out << YAML::BeginMap;
+        out << YAML::Key << "bin_index" << YAML::Value << binIndex;
+        for (const char* var : {"X", "Q", "Z", "PhPerp"}) {
+            out << YAML::Key << (std::string(var) + "_min") << YAML::Value << bin.getMin(var);
+            out << YAML::Key << (std::string(var) + "_max") << YAML::Value << bin.getMax(var);
+        }
+        for (bool useTrue : {false, true}) {
+            const BinSums& s = (useTrue ? truth : reco)[binIndex];
+            out << YAML::Key << (useTrue ? "true" : "reco") << YAML::Value << YAML::BeginMap;
+            out << YAML::Key << "events" << YAML::Value << s.events;
+            out << YAML::Key << "expected_events" << YAML::Value << s.expected;
+            out << YAML::Key << "n_eff_mc" << YAML::Value << s.nEffMC();
+            // RMS of S_T Depol sin(PhiH + PhiS): the analyzing power of the bin
+            out << YAML::Key << "rms_analyzing_power" << YAML::Value << (s.expected > 0 ? std::sqrt(s.sumWg2 / s.expected) : 0.0);
+            out << YAML::Key << "projected_error" << YAML::Value << s.sigma();
+            auto toy = toyErrors.find({binIndex, useTrue});
+            if (toy != toyErrors.end()) {
+                const double toyError = toy->second.meanError;
+                out << YAML::Key << "toy_mean_error" << YAML::Value << toyError;
+                out << YAML::Key << "toy_over_projected" << YAML::Value << (s.sigma() > 0 ? toyError / s.sigma() : 0.0);
+                LOG_INFO("Bin " + std::to_string(binIndex) + (useTrue ? " (true)" : " (reco)") + ": projected " +
+                         std::to_string(s.sigma()) + ", toys " + std::to_string(toyError));
+            }
+            const std::vector<FastToyResult>& fast = useTrue ? trueFast : recoFast;
+            if (static_cast<size_t>(binIndex) < fast.size()) {
+                // Toys sampled from the density, validated against the event-level toys when they are given
+                const FastToyResult& f = fast[binIndex];
+                out << YAML::Key << "fast_toys" << YAML::Value << YAML::BeginMap;
+                out << YAML::Key << "n_toys" << YAML::Value << f.n;
+                out << YAML::Key << "mean_extracted" << YAML::Value << f.meanExtracted;
+                out << YAML::Key << "stddev_extracted" << YAML::Value << f.stddevExtracted;
+                out << YAML::Key << "mean_error" << YAML::Value << f.meanError;
+                if (toy != toyErrors.end()) {
+                    const ToyStats& t = toy->second;
+                    out << YAML::Key << "toy_stddev_extracted" << YAML::Value << t.stddevExtracted;
+                    out << YAML::Key << "stddev_over_toys" << YAML::Value << (t.stddevExtracted > 0 ? f.stddevExtracted / t.stddevExtracted : 0.0);
+                    out << YAML::Key << "error_over_toys" << YAML::Value << (t.meanError > 0 ? f.meanError / t.meanError : 0.0);
+                }
+                out << YAML::EndMap;
+            }
+            out << YAML::EndMap;
+        }
+        out << YAML::EndMap;
+        ++binIndex;
+    }
+    out << YAML::EndSeq;
+    out << YAML::EndMap;
+
+    std::ofstream yamlOut(path);
+    if (!yamlOut.is_open()) {
+        LOG_ERROR("ErrorProjection: could not write YAML " + path);
+        return false;
+    }
+    yamlOut << out.c_str();
+    LOG_INFO("ErrorProjection: wrote projections to " + path);
+    return true;
+}
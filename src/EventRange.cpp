@@ -0,0 +1,95 @@
+#include "EventRange.h"
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+EventRange EventRange::firstN(Long64_t n) {
+    EventRange r;
+    return r.setLast(n);
+}
+
+EventRange& EventRange::setFirst(Long64_t f) {
+    first = std::max<Long64_t>(0, f);
+    return *this;
+}
+
+EventRange& EventRange::setLast(Long64_t l) {
+    last = l < 0 ? -1 : l;
+    return *this;
+}
+
+EventRange& EventRange::setStride(Long64_t s) {
+    if (s < 1)
+        throw std::invalid_argument("EventRange: stride must be >= 1");
+    stride = s;
+    return *this;
+}
+
+EventRange& EventRange::setFraction(double f, uint64_t s) {
+    if (!(f > 0.0 && f <= 1.0))
+        throw std::invalid_argument("EventRange: fraction must be in (0, 1]");
+    fraction = f;
+    seed = s;
+    threshold = f >= 1.0 ? ~0ULL : static_cast<uint64_t>(std::ldexp(f, 64));
+    return *this;
+}
+
+EventRange& EventRange::setEntries(std::vector<Long64_t> list) {
+    std::sort(list.begin(), list.end());
+    list.erase(std::unique(list.begin(), list.end()), list.end());
+    entries = std::make_shared<const std::vector<Long64_t>>(std::move(list));
+    return *this;
+}
+
+bool EventRange::isFull() const {
+    return first == 0 && last < 0 && stride == 1 && threshold == ~0ULL && !entries;
+}
+
+bool EventRange::contains(Long64_t entry) const {
+    if (entry < first || (last >= 0 && entry >= last) || (entry - first) % stride != 0 || !passHash(entry))
+        return false;
+    return !entries || std::binary_search(entries->begin(), entries->end(), entry);
+}
+
+double EventRange::count(Long64_t nEntries) const {
+    const Long64_t hi = last < 0 ? nEntries : std::min(nEntries, last);
+    Long64_t n = 0;
+    if (entries) {
+        for (auto it = std::lower_bound(entries->begin(), entries->end(), first); it != entries->end() && *it < hi; ++it) {
+            if ((*it - first) % stride == 0)
+                ++n;
+        }
+    } else if (hi > first) {
+        n = (hi - first + stride - 1) / stride;
+    }
+    return static_cast<double>(n) * fraction;
+}
+
+double EventRange::acceptance(Long64_t nEntries) const {
+    return nEntries > 0 ? count(nEntries) / static_cast<double>(nEntries) : 0.0;
+}
+
+std::string EventRange::tag() const {
+    if (isFull())
+        return "";
+    std::ostringstream os;
+    os << "__r" << first << "-";
+    if (last >= 0)
+        os << last;
+    else
+        os << "end";
+    if (stride > 1)
+        os << "s" << stride;
+    if (threshold != ~0ULL)
+        os << "f" << fraction << "seed" << seed;
+    if (entries) {
+        // FNV-1a over the explicit entry list
+        unsigned long long h = 1469598103934665603ULL;
+        for (Long64_t e : *entries) {
+            h ^= static_cast<unsigned long long>(e);
+            h *= 1099511628211ULL;
+        }
+        os << "l" << std::hex << h;
+    }
+    return os.str();
+}
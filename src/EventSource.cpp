@@ -0,0 +1,240 @@
+#include "EventSource.h"
+#include "Logger.h"
+#include "TChain.h"
+#include "TFile.h"
+#include "TTree.h"
+#include <ROOT/RNTupleReader.hxx>
+#include <algorithm>
+#include <utility>
+
+namespace {
+const std::vector<std::pair<std::string, double Event::*>>& columnTable() {
+    static const std::vector<std::pair<std::string, double Event::*>> table = {
+        {"X", &Event::X},
+        {"Q2", &Event::Q2},
+        {"Z", &Event::Z},
+        {"PhPerp", &Event::PhPerp},
+        {"PhiH", &Event::PhiH},
+        {"PhiS", &Event::PhiS},
+        {"Y", &Event::Y},
+        {"TrueX", &Event::TrueX},
+        {"TrueQ2", &Event::TrueQ2},
+        {"TrueZ", &Event::TrueZ},
+        {"TruePhPerp", &Event::TruePhPerp},
+        {"TruePhiH", &Event::TruePhiH},
+        {"TruePhiS", &Event::TruePhiS},
+        {"TrueY", &Event::TrueY},
+        {"Weight", &Event::Weight},
+    };
+    return table;
+}
+} // namespace
+
+double Event::*Event::column(const std::string& name) {
+    for (const auto& c : columnTable()) {
+        if (c.first == name)
+            return c.second;
+    }
+    return nullptr;
+}
+
+const std::vector<std::string>& Event::columnNames() {
+    static const std::vector<std::string> names = [] {
+        std::vector<std::string> n;
+        for (const auto& c : columnTable())
+            n.push_back(c.first);
+        return n;
+    }();
+    return names;
+}
+
+// ---------------- TTree ----------------
+
+TreeEventSource::TreeEventSource(TTree* tree)
+    : tree(tree) {
+    bindColumns();
+    offsets = {0, tree->GetEntries()};
+}
+
+TreeEventSource::~TreeEventSource() = default;
+
+std::unique_ptr<TreeEventSource> TreeEventSource::open(const std::vector<std::string>& files, const std::string& treename) {
+    if (files.empty())
+        return nullptr;
+    {
+        std::unique_ptr<TFile> first(TFile::Open(files.front().c_str()));
+        if (!first || first->IsZombie() || !dynamic_cast<TTree*>(first->Get(treename.c_str())))
+            return nullptr;
+    }
+    auto chain = std::make_unique<TChain>(treename.c_str());
+    for (const auto& f : files) {
+        if (chain->Add(f.c_str(), 0) == 0) {
+            LOG_ERROR("TreeEventSource: could not add " + f + " to the chain");
+            return nullptr;
+        }
+    }
+    const Long64_t total = chain->GetEntries();
+    auto src = std::make_unique<TreeEventSource>(chain.get());
+    src->chain = std::move(chain);
+    src->files = files;
+    // Per-file entry offsets (the chain knows them once every header has been read)
+    const Long64_t* treeOffset = src->chain->GetTreeOffset();
+    src->offsets.assign(treeOffset, treeOffset + files.size());
+    src->offsets.push_back(total);
+    return src;
+}
+
+void TreeEventSource::bindColumns() {
+    // Only the columns we use are read from disk
+    tree->SetBranchStatus("*", false);
+    for (const auto& c : columnTable()) {
+        if (!tree->GetBranch(c.first.c_str()))
+            continue;
+        tree->SetBranchStatus(c.first.c_str(), true);
+        tree->SetBranchAddress(c.first.c_str(), &(buffer.*(c.second)));
+        present.push_back(c.first);
+    }
+}
+
+Long64_t TreeEventSource::getEntries() const {
+    return tree->GetEntries();
+}
+
+const Event& TreeEventSource::getEntry(Long64_t entry) {
+    tree->GetEntry(entry);
+    return buffer;
+}
+
+bool TreeEventSource::hasColumn(const std::string& name) const {
+    return std::find(present.begin(), present.end(), name) != present.end();
+}
+
+std::string TreeEventSource::getName() const {
+    return tree->GetName();
+}
+
+size_t TreeEventSource::getNumParts() const {
+    return offsets.size() - 1;
+}
+
+Long64_t TreeEventSource::getPartOffset(size_t part) const {
+    return offsets.at(part);
+}
+
+Long64_t TreeEventSource::getPartEntries(size_t part) const {
+    return offsets.at(part + 1) - offsets.at(part);
+}
+
+std::unique_ptr<EventSource> TreeEventSource::openPart(size_t part) const {
+    // Trees handed in by the caller cannot be reopened
+    if (files.empty())
+        return nullptr;
+    return TreeEventSource::open({files.at(part)}, tree->GetName());
+}
+
+std::unique_ptr<EventSource> TreeEventSource::reopen() const {
+    if (files.empty())
+        return nullptr;
+    return TreeEventSource::open(files, tree->GetName());
+}
+
+// ---------------- RNTuple ----------------
+
+struct RNTupleEventSource::Impl {
+    struct Part {
+        std::unique_ptr<ROOT::RNTupleReader> reader;
+        std::vector<std::pair<double Event::*, ROOT::RNTupleView<double>>> views;
+    };
+    std::vector<Part> parts;
+    std::vector<Long64_t> offsets; // first global entry of each file, plus the total
+    std::vector<std::string> present;
+    size_t current = 0;
+};
+
+RNTupleEventSource::~RNTupleEventSource() = default;
+
+std::unique_ptr<RNTupleEventSource> RNTupleEventSource::open(const std::vector<std::string>& files, const std::string& ntupleName) {
+    if (files.empty())
+        return nullptr;
+    std::unique_ptr<RNTupleEventSource> src(new RNTupleEventSource());
+    src->impl = std::make_unique<Impl>();
+    src->name = ntupleName;
+    src->files = files;
+    src->impl->offsets.push_back(0);
+    for (const auto& f : files) {
+        std::unique_ptr<ROOT::RNTupleReader> reader;
+        try {
+            reader = ROOT::RNTupleReader::Open(ntupleName, f);
+        } catch (const std::exception& e) {
+            LOG_DEBUG(std::string("RNTupleEventSource: ") + e.what());
+            return nullptr;
+        }
+        if (!reader)
+            return nullptr;
+
+        Impl::Part part;
+        const auto& desc = reader->GetDescriptor();
+        const bool first = src->impl->parts.empty();
+        for (const auto& c : columnTable()) {
+            const bool found = desc.FindFieldId(c.first) != ROOT::kInvalidDescriptorId;
+            if (first && found)
+                src->impl->present.push_back(c.first);
+            if (!src->hasColumn(c.first))
+                continue;
+            if (!found) {
+                LOG_ERROR("RNTupleEventSource: field " + c.first + " missing in " + f);
+                return nullptr;
+            }
+            // Each view only decompresses the pages of its own column
+            part.views.emplace_back(c.second, reader->GetView<double>(c.first));
+        }
+        src->impl->offsets.push_back(src->impl->offsets.back() + static_cast<Long64_t>(reader->GetNEntries()));
+        part.reader = std::move(reader);
+        src->impl->parts.push_back(std::move(part));
+    }
+    return src;
+}
+
+Long64_t RNTupleEventSource::getEntries() const {
+    return impl->offsets.back();
+}
+
+const Event& RNTupleEventSource::getEntry(Long64_t entry) {
+    auto& offsets = impl->offsets;
+    if (entry < offsets[impl->current] || entry >= offsets[impl->current + 1]) {
+        auto it = std::upper_bound(offsets.begin(), offsets.end(), entry);
+        impl->current = std::min<size_t>(std::max<ptrdiff_t>(it - offsets.begin() - 1, 0), impl->parts.size() - 1);
+    }
+    const auto idx = static_cast<ROOT::NTupleSize_t>(entry - offsets[impl->current]);
+    for (auto& v : impl->parts[impl->current].views)
+        buffer.*(v.first) = v.second(idx);
+    return buffer;
+}
+
+bool RNTupleEventSource::hasColumn(const std::string& col) const {
+    return std::find(impl->present.begin(), impl->present.end(), col) != impl->present.end();
+}
+
+std::string RNTupleEventSource::getName() const {
+    return name;
+}
+
+size_t RNTupleEventSource::getNumParts() const {
+    return impl->parts.size();
+}
+
+Long64_t RNTupleEventSource::getPartOffset(size_t part) const {
+    return impl->offsets.at(part);
+}
+
+Long64_t RNTupleEventSource::getPartEntries(size_t part) const {
+    return impl->offsets.at(part + 1) - impl->offsets.at(part);
+}
+
+std::unique_ptr<EventSource> RNTupleEventSource::openPart(size_t part) const {
+    return RNTupleEventSource::open({files.at(part)}, name);
+}
+
+std::unique_ptr<EventSource> RNTupleEventSource::reopen() const {
+    return RNTupleEventSource::open(files, name);
+}
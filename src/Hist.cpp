@@ -1,19 +1,23 @@
 #include "Hist.h"
 #include "Logger.h"
+#include "Reduction.h"
 #include "Style.h"
 #include "TApplication.h"
 #include "TArrow.h"
 #include "TCanvas.h"
 #include "TDirectory.h"
-#include "TEntryList.h"
 #include "TFile.h"
 #include "TH1D.h"
 #include "TKey.h"
 #include "TLatex.h"
-#include "TTreeFormula.h"
+#include "TTree.h"
 #include "Utility.h"
+#include <atomic>
+#include <functional>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <stdexcept>
 
 // Pre-determined params for recognized variables
 const std::map<std::string, HistParams> Hist::varParams = {
@@ -27,6 +31,26 @@ const std::map<std::string, HistParams> Hist::varParams = {
 
 const HistParams Hist::defaultParams = {100, 0, 1};
 
+namespace {
+// Column accessor for a histogram or mean variable; "Q" is derived from Q2
+struct VarGetter {
+    double Event::*col = nullptr;
+    bool isQ = false;
+    double operator()(const Event& ev) const {
+        return isQ ? std::sqrt(std::max(0.0, ev.Q2)) : ev.*col;
+    }
+};
+
+VarGetter makeGetter(const std::string& var) {
+    VarGetter g;
+    g.isQ = (var == "Q");
+    g.col = g.isQ ? &Event::Q2 : Event::column(var);
+    if (!g.col)
+        throw std::invalid_argument("Hist: unknown variable '" + var + "'");
+    return g;
+}
+} // namespace
+
 HistParams Hist::getParams(const std::string& var, int nbins, double xmin, double xmax) const {
     auto it = varParams.find(var);
     HistParams params = (it != varParams.end()) ? it->second : defaultParams;
@@ -39,15 +63,15 @@ HistParams Hist::getParams(const std::string& var, int nbins, double xmin, doubl
     return params;
 }
 
-Hist::Hist(TTree* tree)
-    : tree(tree) {
-    m_hasWeightBranch = tree->GetBranch("Weight") != nullptr;
+Hist::Hist(EventSource* source)
+    : source(source) {
+    m_hasWeightBranch = source->hasColumn("Weight");
     if (m_hasWeightBranch) {
-        LOG_INFO("TTree has a 'Weight' branch. It will be used in histogram filling.");
+        LOG_INFO("Input has a 'Weight' column. It will be used in histogram filling.");
     }
 }
 
-void Hist::fillHistograms(const std::string& var, const std::map<std::string, TCut>& binTCuts, double scale) {
+void Hist::fillHistograms(const std::string& var, const std::map<std::string, BinCut>& binCuts, double scale) {
     // Prepare containers
     histMap[var].clear();
     binKeysMap[var].clear();
@@ -55,16 +79,15 @@ void Hist::fillHistograms(const std::string& var, const std::map<std::string, TC
 
     auto params = getParams(var, -1, -1, -1);
 
-    // Pre-create histograms and compile TTreeFormulas for cuts
-    std::vector<std::unique_ptr<TTreeFormula>> binFormulas;
+    // Pre-create histograms and collect the bin selections
+    std::vector<const BinCut*> binSelections;
     std::vector<TH1D*> hists;
     std::vector<std::string> keys;
     std::vector<TCut> cuts;
 
-    int idx = 0;
-    for (const auto& binPair : binTCuts) {
+    for (const auto& binPair : binCuts) {
         const std::string& binKey = binPair.first;
-        const TCut& cut = binPair.second;
+        const TCut& cut = binPair.second.cut;
         std::string histName = "hist_" + binKey;
         TH1D* h = nullptr;
         if (var == "X" || var == "Q") {
@@ -85,59 +108,129 @@ void Hist::fillHistograms(const std::string& var, const std::map<std::string, TC
         hists.push_back(h);
         keys.push_back(binKey);
         cuts.push_back(cut);
-        binFormulas.emplace_back(std::make_unique<TTreeFormula>(("cut_" + std::to_string(idx)).c_str(), cut.GetTitle(), tree));
-        ++idx;
+        binSelections.push_back(&binPair.second);
     }
 
     int totalBins = static_cast<int>(hists.size());
     if (totalBins == 0)
         return;
 
-    // Prepare formulas for variable, weight, and mean variables
-    std::unique_ptr<TTreeFormula> varFormula = std::make_unique<TTreeFormula>("varFormula", var.c_str(), tree);
-    std::unique_ptr<TTreeFormula> weightFormula;
-    if (m_hasWeightBranch)
-        weightFormula = std::make_unique<TTreeFormula>("weightFormula", "Weight", tree);
+    // Resolve accessors for variable and mean variables once
+    VarGetter varGetter = makeGetter(var);
     std::vector<std::string> meanVars = {"X", "Q", "Z", "PhPerp"};
-    std::vector<std::unique_ptr<TTreeFormula>> meanFormulas;
+    std::vector<VarGetter> meanGetters;
     for (const auto& mvar : meanVars) {
-        meanFormulas.emplace_back(std::make_unique<TTreeFormula>(("mean_" + mvar).c_str(), mvar.c_str(), tree));
+        meanGetters.push_back(makeGetter(mvar));
     }
 
-    // Accumulators for means: per-bin per-meanVar
-    std::vector<std::vector<double>> sumW(totalBins, std::vector<double>(1, 0.0)); // total weight per bin
-    std::vector<std::vector<double>> sumWV(totalBins, std::vector<double>(meanVars.size(), 0.0));
+    // Histograms and weight sums filled by one pass over (part of) the input; the sums for the means are per bin
+    // and per bin and mean variable
+    struct Partial {
+        std::vector<TH1D*> hists;
+        std::vector<CompensatedSum> sumW;
+        std::vector<std::vector<CompensatedSum>> sumWV;
+        Long64_t nProcessed = 0;
+    };
+    // Fills the global entries [begin, end) read from src, whose first entry is global entry `offset`
+    auto fillRange = [&](EventSource& src, Long64_t offset, Long64_t begin, Long64_t end, Partial& out,
+                         const std::function<void(Long64_t)>& progress) {
+        std::vector<double> mvals(meanGetters.size());
+        auto processEntry = [&](Long64_t i) {
+            const Event& ev = src.getEntry(i - offset);
 
-    // Single pass over entries with progress
-    TEntryList* el = tree->GetEntryList();
-    Long64_t nentries = (el ? el->GetN() : tree->GetEntries());
-    util::ProgressBar pbar(static_cast<size_t>(nentries), 60, "Filling");
-    for (Long64_t i = 0; i < nentries; ++i) {
-        tree->GetEntry(i);
-
-        double v = varFormula->EvalInstance();
-        double w = m_hasWeightBranch ? weightFormula->EvalInstance() : 1.0;
-        w *= scale;
-        // evaluate mean vars once
-        std::vector<double> mvals;
-        mvals.reserve(meanFormulas.size());
-        for (auto& mf : meanFormulas)
-            mvals.push_back(mf->EvalInstance());
+            double v = varGetter(ev);
+            double w = m_hasWeightBranch ? ev.Weight : 1.0;
+            w *= scale;
+            // evaluate mean vars once
+            for (size_t k = 0; k < meanGetters.size(); ++k)
+                mvals[k] = meanGetters[k](ev);
 
-        // check each bin formula
-        for (int b = 0; b < totalBins; ++b) {
-            double pass = binFormulas[b]->EvalInstance();
-            if (pass) {
-                hists[b]->Fill(v, w);
-                sumW[b][0] += w;
-                for (size_t k = 0; k < meanVars.size(); ++k) {
-                    sumWV[b][k] += mvals[k] * w;
+            // check each bin selection
+            for (int b = 0; b < totalBins; ++b) {
+                if (binSelections[b]->pass(ev)) {
+                    out.hists[b]->Fill(v, w);
+                    out.sumW[b] += w;
+                    for (size_t k = 0; k < meanVars.size(); ++k) {
+                        out.sumWV[b][k] += mvals[k] * w;
+                    }
                 }
             }
+
+            if ((++out.nProcessed & 0x3FF) == 0)
+                progress(out.nProcessed);
+        };
+        range.forEach(begin, end, processEntry);
+    };
+
+    // Single pass over the entries of the event range, with progress
+    const Long64_t nentries = source->getEntries();
+    const Long64_t expected = static_cast<Long64_t>(std::ceil(range.count(nentries)));
+    util::ProgressBar pbar(static_cast<size_t>(expected), 60, "Filling");
+
+    // Histograms and sums of every file, merged in file order: the reduction tree is fixed by the input files, so the
+    // result is bit-identical on any number of threads. With several threads each file gets a private reader;
+    // otherwise the files are filled one after the other.
+    const size_t nParts = source->getNumParts();
+    std::vector<std::unique_ptr<EventSource>> partSources;
+    if (nThreads > 1 && nParts > 1) {
+        for (size_t p = 0; p < nParts; ++p) {
+            partSources.push_back(source->openPart(p));
+            if (!partSources.back()) {
+                partSources.clear();
+                break;
+            }
         }
+    }
 
-        if ((i & 0x3FF) == 0)
-            pbar.update(static_cast<size_t>(i));
+    auto emptyPartial = [&](const std::vector<TH1D*>& h) {
+        return Partial{h, std::vector<CompensatedSum>(totalBins),
+                       std::vector<std::vector<CompensatedSum>>(totalBins, std::vector<CompensatedSum>(meanVars.size()))};
+    };
+    auto makePartial = [&](size_t p) {
+        Partial part = emptyPartial({});
+        for (int b = 0; b < totalBins; ++b) {
+            auto* hc = static_cast<TH1D*>(hists[b]->Clone((keys[b] + "_part" + std::to_string(p)).c_str()));
+            hc->SetDirectory(nullptr);
+            part.hists.push_back(hc);
+        }
+        return part;
+    };
+    Partial total = emptyPartial(hists);
+    auto mergePart = [&](Partial& part) {
+        for (int b = 0; b < totalBins; ++b) {
+            total.hists[b]->Add(part.hists[b]);
+            delete part.hists[b];
+            total.sumW[b].merge(part.sumW[b]);
+            for (size_t k = 0; k < meanVars.size(); ++k)
+                total.sumWV[b][k].merge(part.sumWV[b][k]);
+        }
+        total.nProcessed += part.nProcessed;
+    };
+    std::mutex pbarMutex;
+    std::atomic<Long64_t> done{0};
+    auto progress = [&](Long64_t) {
+        const Long64_t n = (done += 0x400);
+        std::lock_guard<std::mutex> lock(pbarMutex);
+        pbar.update(static_cast<size_t>(std::min(n, expected)));
+    };
+    if (partSources.empty()) {
+        for (size_t p = 0; p < nParts; ++p) {
+            Partial part = makePartial(p);
+            const Long64_t offset = source->getPartOffset(p);
+            fillRange(*source, 0, offset, offset + source->getPartEntries(p), part, progress);
+            mergePart(part);
+        }
+    } else {
+        std::vector<Partial> partials;
+        for (size_t p = 0; p < partSources.size(); ++p)
+            partials.push_back(makePartial(p));
+        LOG_INFO("Filling " + std::to_string(partSources.size()) + " input files on " + std::to_string(nThreads) + " threads.");
+        util::parallelFor(partSources.size(), nThreads, [&](size_t p) {
+            const Long64_t offset = source->getPartOffset(p);
+            fillRange(*partSources[p], offset, offset, offset + source->getPartEntries(p), partials[p], progress);
+        });
+        for (auto& part : partials)
+            mergePart(part);
     }
     pbar.finish();
 
@@ -147,11 +240,11 @@ void Hist::fillHistograms(const std::string& var, const std::map<std::string, TC
         binKeysMap[var].push_back(keys[b]);
         binCutsMap[var].push_back(cuts[b]);
         // compute means for stored vars
-        double totalW = sumW[b][0];
+        double totalW = total.sumW[b].value();
         std::string binKey = keys[b];
         if (totalW > 0.0) {
             for (size_t k = 0; k < meanVars.size(); ++k) {
-                meanMap[binKey][meanVars[k]] = sumWV[b][k] / totalW;
+                meanMap[binKey][meanVars[k]] = total.sumWV[b][k].value() / totalW;
             }
         } else {
             for (const auto& mv : meanVars)
@@ -159,7 +252,7 @@ void Hist::fillHistograms(const std::string& var, const std::map<std::string, TC
         }
     }
 
-    std::cout << "Processed " << nentries << " entries; filled " << totalBins << " histograms." << std::endl;
+    std::cout << "Processed " << total.nProcessed << " entries; filled " << totalBins << " histograms." << std::endl;
 }
 
 bool Hist::saveHistCache(const std::string& cacheFile, const std::string& var) const {
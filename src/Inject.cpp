@@ -1,4 +1,7 @@
 #include "Inject.h"
+#include "CounterRng.h"
+#include "FastToys.h"
+#include "Reduction.h"
 #include <RooArgSet.h>
 #include <RooDataSet.h>
 #include <RooFit.h>
@@ -7,277 +10,1083 @@
 #include <RooRealVar.h>
 #include <RooFormulaVar.h>
 #include <TMath.h>
-#include <TRandom3.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <iostream>
 #include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
 
 using namespace RooFit;
 
-Inject::Inject(TTree* tree, const Table* table, double scale, double targetPolarization)
-    : tree(tree)
-    , table(table)
-    , m_scale(scale)
-    , targetPolarization(targetPolarization) {}
-Inject::~Inject() {}
-
+namespace {
 
+// RooFit is not thread-safe (RooNameReg, the formula JIT of RooGenericPdf and RooFormulaVar, the message service):
+// injectors on concurrent workers build, fit and destroy their RooFit objects one at a time. Filling a dataset
+// only touches the injector's own objects and runs unlocked.
+std::mutex rooFitMutex;
 
-std::pair<double, double> Inject::injectExtractForBin(const Bin& bin, bool extract_with_true, std::optional<double> A_opt) {
-    if (!tree) {
-        std::cerr << "[Inject::injectExtractForBin] Error: TTree pointer is null." << std::endl;
-        return std::make_pair(0.0, 0.0);
+// Inclusive bin bounds, as applied by the event selection
+struct BinBounds {
+    double minX, maxX, minQ2, maxQ2, minZ, maxZ, minPhPerp, maxPhPerp;
+    explicit BinBounds(const Bin& bin)
+        : minX(bin.getMin("X")), maxX(bin.getMax("X")), minQ2(bin.getMin("Q") * bin.getMin("Q")),
+          maxQ2(bin.getMax("Q") * bin.getMax("Q")), minZ(bin.getMin("Z")), maxZ(bin.getMax("Z")),
+          minPhPerp(bin.getMin("PhPerp")), maxPhPerp(bin.getMax("PhPerp")) {}
+    bool contains(double x, double q2, double z, double phPerp) const {
+        return x >= minX && x <= maxX && q2 >= minQ2 && q2 <= maxQ2 && z >= minZ && z <= maxZ && phPerp >= minPhPerp &&
+               phPerp <= maxPhPerp;
     }
+};
 
-    RooRealVar Y("Y", "Y", 0.0, 1.0);
-    RooRealVar PhiH("PhiH", "PhiH", -2*TMath::Pi(), 2*TMath::Pi());
-    RooRealVar PhiS("PhiS", "PhiS", -2*TMath::Pi(), 2*TMath::Pi());
-    RooRealVar X("X", "X", bin.getMin("X"), bin.getMax("X"));
-    RooFormulaVar Depol1("Depol1", "(1 - Y)/(1 - Y + 0.5 * Y * Y)", RooArgList(Y));
+// Datasets filled by the loop: the reco-binned one (fit with reco kinematics), the true-binned one
+// (fit with true kinematics) or both from the same toy
+struct RecoKin {
+    static constexpr bool fitsReco = true;
+    static constexpr bool fitsTrue = false;
+};
+struct TrueKin {
+    static constexpr bool fitsReco = false;
+    static constexpr bool fitsTrue = true;
+};
+struct BothKin {
+    static constexpr bool fitsReco = true;
+    static constexpr bool fitsTrue = true;
+};
 
-    RooRealVar Q2("Q2", "Q2", bin.getMin("Q")*bin.getMin("Q"), bin.getMax("Q")*bin.getMax("Q"));
-    RooRealVar Z("Z", "Z", bin.getMin("Z"), bin.getMax("Z"));
-    RooRealVar PhPerp("PhPerp", "PhPerp", bin.getMin("PhPerp"), bin.getMax("PhPerp"));
-
-    RooRealVar TrueY("TrueY", "TrueY", -999, 999);
-    RooFormulaVar TrueDepol1("TrueDepol1", "(1 - TrueY)/(1 - TrueY + 0.5 * TrueY * TrueY)", RooArgList(TrueY));
-    RooRealVar TruePhiH("TruePhiH", "TruePhiH", -2*TMath::Pi(), 2*TMath::Pi());
-    RooRealVar TruePhiS("TruePhiS", "TruePhiS", -2*TMath::Pi(), 2*TMath::Pi());
-    RooRealVar TrueQ2("TrueQ2", "TrueQ2", -999, 99999999);
-    RooRealVar TrueX("TrueX", "TrueX", -999, 999);
-    RooRealVar TrueZ("TrueZ", "TrueZ", -999, 999);
-    RooRealVar TruePhPerp("TruePhPerp", "TruePhPerp", -999, 999);
+// Injected asymmetry of the k-th prepared event: a fixed amplitude (--A_opt) or the table at the true
+// or reco kinematics. The reco value is only used to report the asymmetry a reco-level analysis would expect.
+// modulation() is the spin asymmetry the spin is drawn from, P(up) = (1 + modulation)/2 before polarization.
+struct FixedAsym {
+    const PreparedBin& prep;
+    double A;
+    double trueAUT(size_t) const {
+        return A;
+    }
+    double recoAUT(size_t) const {
+        return A;
+    }
+    double modulation(size_t k) const {
+        return prep.truth.S_T[k] * prep.truth.Depol[k] * A * prep.truth.SinPhi[k];
+    }
+};
+struct TableAsym {
+    const PreparedBin& prep;
+    double trueAUT(size_t k) const {
+        return prep.trueAUT[k];
+    }
+    double recoAUT(size_t k) const {
+        return prep.recoAUT[k];
+    }
+    double modulation(size_t k) const {
+        return prep.truth.S_T[k] * prep.truth.Depol[k] * prep.trueAUT[k] * prep.truth.SinPhi[k];
+    }
+};
+// Several modulations injected together; the reported asymmetries are those of the first modulation
+struct ModulatedAsym {
+    const PreparedBin& prep;
+    const std::vector<std::optional<double>>& A;
+    double trueAUT(size_t k) const {
+        return A[0].has_value() ? A[0].value() : prep.trueAUT[k];
+    }
+    double recoAUT(size_t k) const {
+        return A[0].has_value() ? A[0].value() : prep.recoAUT[k];
+    }
+    double modulation(size_t k) const {
+        const size_t K = A.size();
+        const double* b = &prep.trueBasis[k * K];
+        double s = 0.0;
+        for (size_t m = 0; m < K; ++m)
+            s += (A[m].has_value() ? A[m].value() : prep.trueAUT[k]) * b[m];
+        return s;
+    }
+};
 
-    RooRealVar Spin_idx("Spin_idx", "Spin_idx", -1, 1);
-    RooRealVar Weight("Weight", "Weight", 0, 1e9);
-    RooRealVar TotalWeight("TotalWeight", "TotalWeight", 0, 1e9);
-    RooRealVar tPol("tPol", "Target Polarization", targetPolarization); 
-    tPol.setConstant(true);
+// RooFit observables of the injected dataset
+struct Observables {
+    RooRealVar Y, PhiH, PhiS, X;
+    RooFormulaVar Depol1;
+    RooRealVar Q2, Z, PhPerp;
+    RooRealVar TrueY;
+    RooFormulaVar TrueDepol1;
+    RooRealVar TruePhiH, TruePhiS, TrueQ2, TrueX, TrueZ, TruePhPerp;
+    RooRealVar Spin_idx, Weight, TotalWeight, tPol;
+    RooRealVar S_T, TrueS_T;
+    RooArgSet obs;
 
-    RooRealVar Gamma("Gamma", "Gamma (2*X*0.938272/sqrt(Q2))", -999, 999);
-    RooRealVar TrueGamma("TrueGamma", "TrueGamma (2*TrueX*0.938272/sqrt(TrueQ2))", -999, 999);
-    RooRealVar S_T("S_T", "Transverse spin magnitude S_T", -999, 999);
-    RooRealVar TrueS_T("TrueS_T", "Transverse spin magnitude TrueS_T", -999, 999);
+    Observables(const Bin& bin, double targetPolarization)
+        : Y("Y", "Y", 0.0, 1.0)
+        , PhiH("PhiH", "PhiH", -2*TMath::Pi(), 2*TMath::Pi())
+        , PhiS("PhiS", "PhiS", -2*TMath::Pi(), 2*TMath::Pi())
+        , X("X", "X", bin.getMin("X"), bin.getMax("X"))
+        , Depol1("Depol1", "(1 - Y)/(1 - Y + 0.5 * Y * Y)", RooArgList(Y))
+        , Q2("Q2", "Q2", bin.getMin("Q")*bin.getMin("Q"), bin.getMax("Q")*bin.getMax("Q"))
+        , Z("Z", "Z", bin.getMin("Z"), bin.getMax("Z"))
+        , PhPerp("PhPerp", "PhPerp", bin.getMin("PhPerp"), bin.getMax("PhPerp"))
+        , TrueY("TrueY", "TrueY", -999, 999)
+        , TrueDepol1("TrueDepol1", "(1 - TrueY)/(1 - TrueY + 0.5 * TrueY * TrueY)", RooArgList(TrueY))
+        , TruePhiH("TruePhiH", "TruePhiH", -2*TMath::Pi(), 2*TMath::Pi())
+        , TruePhiS("TruePhiS", "TruePhiS", -2*TMath::Pi(), 2*TMath::Pi())
+        , TrueQ2("TrueQ2", "TrueQ2", -999, 99999999)
+        , TrueX("TrueX", "TrueX", -999, 999)
+        , TrueZ("TrueZ", "TrueZ", -999, 999)
+        , TruePhPerp("TruePhPerp", "TruePhPerp", -999, 999)
+        , Spin_idx("Spin_idx", "Spin_idx", -1, 1)
+        , Weight("Weight", "Weight", 0, 1e9)
+        , TotalWeight("TotalWeight", "TotalWeight", 0, 1e9)
+        , tPol("tPol", "Target Polarization", targetPolarization)
+        , S_T("S_T", "Transverse spin magnitude S_T", -999, 999)
+        , TrueS_T("TrueS_T", "Transverse spin magnitude TrueS_T", -999, 999) {
+        tPol.setConstant(true);
+        obs.add(PhiH);
+        obs.add(PhiS);
+        obs.add(X);
+        obs.add(Q2);
+        obs.add(Z);
+        obs.add(Y);
+        obs.add(PhPerp);
+        obs.add(TruePhiH);
+        obs.add(TruePhiS);
+        obs.add(TrueX);
+        obs.add(TrueQ2);
+        obs.add(TrueY);
+        obs.add(TrueZ);
+        obs.add(TruePhPerp);
+        obs.add(Spin_idx);
+        obs.add(Weight);
+        obs.add(S_T);
+        obs.add(TrueS_T);
+    }
+};
 
-    RooArgSet obs;
-    obs.add(PhiH);
-    obs.add(PhiS);
-    obs.add(X);
-    obs.add(Q2);
-    obs.add(Z);
-    obs.add(Y);
-    obs.add(PhPerp);
-    obs.add(TruePhiH);
-    obs.add(TruePhiS);
-    obs.add(TrueX);
-    obs.add(TrueQ2);
-    obs.add(TrueY);
-    obs.add(TrueZ);
-    obs.add(TruePhPerp);
-    obs.add(Spin_idx);
-    obs.add(Weight);
-
-    std::string cut = "";
-    if(extract_with_true){
-        cut =
-            "TrueX >= " + std::to_string(bin.getMin("X")) + " && TrueX <= " + std::to_string(bin.getMax("X")) +
-            " && TrueQ2 >= " + std::to_string(bin.getMin("Q")*bin.getMin("Q")) +
-            " && TrueQ2 <= " + std::to_string(bin.getMax("Q")*bin.getMax("Q")) +
-            " && TrueZ >= " + std::to_string(bin.getMin("Z")) + " && TrueZ <= " + std::to_string(bin.getMax("Z")) +
-            " && TruePhPerp >= " + std::to_string(bin.getMin("PhPerp")) +
-            " && TruePhPerp <= " + std::to_string(bin.getMax("PhPerp"));
-    }
-    else{
-        cut =
-        "X >= " + std::to_string(bin.getMin("X")) + " && X <= " + std::to_string(bin.getMax("X")) +
-        " && Q2 >= " + std::to_string(bin.getMin("Q")*bin.getMin("Q")) +
-        " && Q2 <= " + std::to_string(bin.getMax("Q")*bin.getMax("Q")) +
-        " && Z >= " + std::to_string(bin.getMin("Z")) + " && Z <= " + std::to_string(bin.getMax("Z")) +
-        " && PhPerp >= " + std::to_string(bin.getMin("PhPerp")) +
-        " && PhPerp <= " + std::to_string(bin.getMax("PhPerp"));
-    }
-    
-    // Set up branch variables
-    double b_PhiH=0, b_PhiS=0, b_X=0, b_Q2=0, b_Z=0, b_PhPerp=0;
-    double b_TruePhiH=0, b_TruePhiS=0, b_TrueX=0, b_TrueQ2=0, b_TrueY=0, b_TrueZ=0, b_TruePhPerp=0;
-    double b_Weight=0, b_Y=0;
-
-    tree->SetBranchAddress("PhiH", &b_PhiH);
-    tree->SetBranchAddress("PhiS", &b_PhiS);
-    tree->SetBranchAddress("X", &b_X);
-    tree->SetBranchAddress("Q2", &b_Q2);
-    tree->SetBranchAddress("Z", &b_Z);
-    tree->SetBranchAddress("PhPerp", &b_PhPerp);
-    tree->SetBranchAddress("TruePhiH", &b_TruePhiH);
-    tree->SetBranchAddress("TruePhiS", &b_TruePhiS);
-    tree->SetBranchAddress("TrueX", &b_TrueX);
-    tree->SetBranchAddress("TrueQ2", &b_TrueQ2);
-    tree->SetBranchAddress("TrueY", &b_TrueY);
-    tree->SetBranchAddress("TrueZ", &b_TrueZ);
-    tree->SetBranchAddress("TruePhPerp", &b_TruePhPerp);
-    tree->SetBranchAddress("Weight", &b_Weight);
-    tree->SetBranchAddress("Y", &b_Y);
-
-    obs.add(S_T);
-    obs.add(TrueS_T);
-    RooDataSet dataUpdate("dataUpdate", "data with updated spin", obs, WeightVar(TotalWeight));
-    TRandom3 rng(0);
+struct LoopSums {
+    Long64_t selected = 0;
     double expected_events = 0.0;
     double sumW = 0.0;
     double sumW2 = 0.0;
     double sumTrueAsymW = 0.0;
     double sumRecoAsymW = 0.0;
+};
 
-    // Precompute selection bounds for speed
-    const double minX = bin.getMin("X");
-    const double maxX = bin.getMax("X");
-    const double minQ2 = bin.getMin("Q") * bin.getMin("Q");
-    const double maxQ2 = bin.getMax("Q") * bin.getMax("Q");
-    const double minZ = bin.getMin("Z");
-    const double maxZ = bin.getMax("Z");
-    const double minPhPerp = bin.getMin("PhPerp");
-    const double maxPhPerp = bin.getMax("PhPerp");
-
-    Long64_t nentries = tree->GetEntries();
-    Long64_t selected_count = 0;
-    // Prepare progress bar printing
-    const Long64_t progress_steps = std::min<Long64_t>(100, std::max<Long64_t>(1, nentries/100));
-    Long64_t next_progress = progress_steps;
-    for (Long64_t i = 0; i < nentries; ++i) {
-        tree->GetEntry(i);
-        // Update progress bar occasionally
-        if (i >= next_progress || i == 0 || i == nentries-1) {
-            int percent = static_cast<int>(100.0 * (i+1) / std::max<Long64_t>(1, nentries));
-            std::cout << "\r[" << percent << "%] Processing entry " << (i+1) << " / " << nentries << std::flush;
-            next_progress = i + progress_steps;
-            if (i == nentries-1) std::cout << std::endl;
+// Per-dataset sums of one toy (only the datasets of the loop variant are filled)
+struct DatasetSums {
+    LoopSums reco;
+    LoopSums truth;
+};
+
+// LoopSums of one dataset while the toy loop runs, with compensated sums (see Reduction.h)
+struct LoopAccumulator {
+    Long64_t selected = 0;
+    CompensatedSum expected_events, sumW, sumW2, sumTrueAsymW, sumRecoAsymW;
+    LoopSums sums() const {
+        return LoopSums{selected, expected_events.value(), sumW.value(), sumW2.value(), sumTrueAsymW.value(), sumRecoAsymW.value()};
+    }
+};
+
+// Per-event buffers of the toy loop, kept across injections so they are only allocated for the first one
+struct LoopBuffers {
+    std::vector<double> pPlus;
+    std::vector<int> spins;
+};
+
+// Toy loop specialized on the datasets it fills, on the asymmetry source and on where the events go
+// (Sink), so each mode only computes what it uses. The spin is always drawn from the true kinematics
+// and keyed by the entry, so an event selected in both datasets carries the same spin in each.
+// Asimov: no spins are drawn; every event enters with both spin states, weighted by their probabilities.
+template <typename Kin, bool Asimov, typename Asym, typename Sink>
+DatasetSums injectEvents(const PreparedBin& p, const Asym& asym, double polarization, double scale, const SpinStream& stream,
+                         LoopBuffers& buffers, Sink& sink) {
+    LoopAccumulator reco, truth;
+    const size_t n = p.size();
+
+    // Probability of spin up for every event
+    std::vector<double>& pPlus = buffers.pPlus;
+    pPlus.resize(n);
+    for (size_t k = 0; k < n; ++k) {
+        const double a = asym.trueAUT(k);
+        const double w = p.events[k].Weight;
+        pPlus[k] = 0.5 * (1 + asym.modulation(k));
+        if (Kin::fitsTrue && p.inTrue[k])
+            truth.sumTrueAsymW += w * a;
+        if (Kin::fitsReco && p.inReco[k]) {
+            reco.sumTrueAsymW += w * a;
+            reco.sumRecoAsymW += w * asym.recoAUT(k);
         }
-        // Apply selection cuts using either true or reconstructed variables
-        if (extract_with_true) {
-            if (!(b_TrueX >= minX && b_TrueX <= maxX && b_TrueQ2 >= minQ2 && b_TrueQ2 <= maxQ2 && b_TrueZ >= minZ && b_TrueZ <= maxZ && b_TruePhPerp >= minPhPerp && b_TruePhPerp <= maxPhPerp)) continue;
-        } else {
-            if (!(b_X >= minX && b_X <= maxX && b_Q2 >= minQ2 && b_Q2 <= maxQ2 && b_Z >= minZ && b_Z <= maxZ && b_PhPerp >= minPhPerp && b_PhPerp <= maxPhPerp)) continue;
+    }
+
+    // Spins from the counter-based stream keyed by the input entry, so a toy does not depend on
+    // the order or chunking in which events are visited
+    std::vector<int>& spins = buffers.spins;
+    spins.resize(Asimov ? 0 : n);
+    for (size_t k = 0; k < spins.size(); ++k) {
+        const auto u = stream.draw(static_cast<uint64_t>(p.entries[k]));
+        int spin = u[0] < pPlus[k] ? 1 : -1;
+        if (u[1] > polarization) {
+            // Unpolarized fraction: spin up or down with 50/50 chance
+            spin = u[2] < 0.5 ? 1 : -1;
         }
-        ++selected_count;
+        spins[k] = spin;
+    }
+
+    auto accumulate = [](LoopAccumulator& s, double weight, double totalWeight) {
+        ++s.selected;
+        s.expected_events += totalWeight;
+        s.sumW += weight;
+        s.sumW2 += weight * weight;
+    };
+    for (size_t k = 0; k < n; ++k) {
+        const Event& ev = p.events[k];
+        const double totalWeight = ev.Weight * scale;
+        sink.load(k, totalWeight);
+        auto add = [&](bool useTrue) {
+            if constexpr (Asimov) {
+                // Spin up with probability P pPlus + (1 - P)/2, including the unpolarized fraction
+                const double up = polarization * pPlus[k] + 0.5 * (1 - polarization);
+                sink.add(useTrue, k, 1, totalWeight * up);
+                sink.add(useTrue, k, -1, totalWeight * (1 - up));
+            } else {
+                sink.add(useTrue, k, spins[k], 1.0);
+            }
+        };
+        if (Kin::fitsReco && p.inReco[k]) {
+            add(false);
+            accumulate(reco, ev.Weight, totalWeight);
+        }
+        if (Kin::fitsTrue && p.inTrue[k]) {
+            add(true);
+            accumulate(truth, ev.Weight, totalWeight);
+        }
+    }
+    return DatasetSums{reco.sums(), truth.sums()};
+}
+
+// Sinks are kept by the injector across injections: begin() binds one to a prepared bin and empties it without
+// releasing its buffers, so after the first injection of a bin the sinks no longer allocate.
+
+// Signed analyzing power x = P S_T Depol sin(PhiH + PhiS) s, weight and input entry of every dataset entry:
+// all the unbinned single-amplitude likelihood sum w log(1 + x A) depends on
+struct ScoreSink {
+    const PreparedBin* p = nullptr;
+    double polarization = 1.0;
+    std::vector<double> x[2], w[2]; // [reco, true][dataset entry]
+    std::vector<Long64_t> entry[2];
+    void begin(const PreparedBin& prep, double pol) {
+        p = &prep;
+        polarization = pol;
+        for (int d = 0; d < 2; ++d) {
+            x[d].clear();
+            w[d].clear();
+            entry[d].clear();
+        }
+    }
+    void load(size_t, double) {}
+    void add(bool useTrue, size_t k, int spin, double weight) {
+        const KinematicsBatch& kin = useTrue ? p->truth : p->reco;
+        x[useTrue].push_back(polarization * kin.S_T[k] * kin.Depol[k] * kin.SinPhi[k] * spin);
+        w[useTrue].push_back(weight);
+        entry[useTrue].push_back(p->entries[k]);
+    }
+};
 
+// Events go to the unbinned RooDataSets, and their scores are kept for the closed-form error
+struct DataSetSink {
+    const PreparedBin& p;
+    Observables& o;
+    RooDataSet* recoData;
+    RooDataSet* trueData;
+    ScoreSink& scores;
+    void load(size_t k, double totalWeight) {
+        const Event& ev = p.events[k];
         // Populate RooRealVars from branch values
-        TruePhiH.setVal(b_TruePhiH);
-        TruePhiS.setVal(b_TruePhiS);
-        TrueY.setVal(b_TrueY);
-        TrueX.setVal(b_TrueX);
-        X.setVal(b_X);
-        Z.setVal(b_Z);
-        PhPerp.setVal(b_PhPerp);
-        PhiH.setVal(b_PhiH);
-        PhiS.setVal(b_PhiS);
-        Y.setVal(b_Y);
-        Weight.setVal(b_Weight);
-        TotalWeight.setVal(Weight.getVal() * m_scale);
-
-        // Compute gammas from X and Q2 (protect against non-positive Q2)
-        if (b_Q2 > 0) {
-            Gamma.setVal(2.0 * X.getVal() * 0.938272 / std::sqrt(b_Q2));
-        } else {
-            Gamma.setVal(0.0);
+        o.TruePhiH.setVal(ev.TruePhiH);
+        o.TruePhiS.setVal(ev.TruePhiS);
+        o.TrueY.setVal(ev.TrueY);
+        o.TrueX.setVal(ev.TrueX);
+        o.X.setVal(ev.X);
+        o.Z.setVal(ev.Z);
+        o.PhPerp.setVal(ev.PhPerp);
+        o.PhiH.setVal(ev.PhiH);
+        o.PhiS.setVal(ev.PhiS);
+        o.Y.setVal(ev.Y);
+        o.Weight.setVal(ev.Weight);
+        o.TotalWeight.setVal(totalWeight);
+        o.TrueS_T.setVal(p.truth.S_T[k]);
+        if (p.fitsReco)
+            o.S_T.setVal(p.reco.S_T[k]);
+    }
+    void add(bool useTrue, size_t k, int spin, double weight) {
+        o.Spin_idx.setVal(spin);
+        (useTrue ? trueData : recoData)->add(o.obs, weight);
+        scores.add(useTrue, k, spin, weight);
+    }
+};
+
+// Events go to spin-up/spin-down histograms of the analyzing power (cells prepared once per bin)
+struct HistogramSink {
+    const PreparedBin* p = nullptr;
+    std::vector<double> up[2], down[2]; // [reco, true][cell]
+    std::vector<double> c;              // fit buffer: polarization times the mean analyzing power of each cell
+    void begin(const PreparedBin& prep) {
+        p = &prep;
+        for (int d = 0; d < 2; ++d) {
+            up[d].assign(p->nCells, 0.0);
+            down[d].assign(p->nCells, 0.0);
         }
-        if (b_TrueQ2 > 0) {
-            TrueGamma.setVal(2.0 * TrueX.getVal() * 0.938272 / std::sqrt(b_TrueQ2));
-        } else {
-            TrueGamma.setVal(0.0);
+    }
+    void load(size_t, double) {}
+    void add(bool useTrue, size_t k, int spin, double weight) {
+        const int cell = (useTrue ? p->trueCell : p->recoCell)[k];
+        (spin > 0 ? up : down)[useTrue][cell] += weight;
+    }
+};
+
+// Events merged into super-events of equal signed analyzing power x = P S_T Depol sin(PhiH + PhiS) s, in cells of
+// width `tolerance`. The unbinned likelihood sum w log(1 + x A) depends on nothing else, so a super-event with the
+// summed weights at the weighted mean x of its members reproduces it up to the spread of x within a cell. The
+// exact information at A = 0 is summed along, to report what the merging changes in the error.
+struct AggregateSink {
+    struct SuperEvent {
+        double sumW = 0.0;
+        double sumW2 = 0.0;
+        double sumWX = 0.0;
+    };
+    const PreparedBin* p = nullptr;
+    double polarization = 1.0;
+    double tolerance = 0.0;
+    std::vector<SuperEvent> cells[2]; // [reco, true][x cell]
+    double exactH[2] = {0.0, 0.0};    // sum w x^2
+    double exactB[2] = {0.0, 0.0};    // sum w^2 x^2
+    std::vector<double> W, W2, x, none; // fit buffers: the occupied super-events
+    void begin(const PreparedBin& prep, double pol, double tol) {
+        p = &prep;
+        polarization = pol;
+        tolerance = tol;
+        const size_t nCells = static_cast<size_t>(std::ceil(2.0 / tolerance)) + 1;
+        for (int d = 0; d < 2; ++d) {
+            cells[d].assign(nCells, SuperEvent{});
+            exactH[d] = 0.0;
+            exactB[d] = 0.0;
         }
+    }
+    void load(size_t, double) {}
+    void add(bool useTrue, size_t k, int spin, double weight) {
+        const KinematicsBatch& kin = useTrue ? p->truth : p->reco;
+        const double x = polarization * kin.S_T[k] * kin.Depol[k] * kin.SinPhi[k] * spin;
+        if (!std::isfinite(x))
+            return;
+        std::vector<SuperEvent>& c = cells[useTrue];
+        const size_t cell = static_cast<size_t>(std::clamp((x + 1.0) / tolerance, 0.0, static_cast<double>(c.size() - 1)));
+        c[cell].sumW += weight;
+        c[cell].sumW2 += weight * weight;
+        c[cell].sumWX += weight * x;
+        exactH[useTrue] += weight * x * x;
+        exactB[useTrue] += weight * weight * x * x;
+    }
+};
+
+// Events go to the spin moments v = sum w s b of the modulation basis. The basis moments of the toys (unit
+// weights) are prepared with the bin; Asimov datasets weight the events, so they accumulate their own.
+struct MomentSink {
+    const PreparedBin* p = nullptr;
+    bool weighted = false;
+    std::vector<double> v[2]; // [reco, true][modulation]
+    ModulationMoments moments[2];
+    std::vector<double> A, cov; // fit buffers
+    void begin(const PreparedBin& prep, bool asimov) {
+        p = &prep;
+        weighted = asimov;
+        const int K = static_cast<int>(p->modulations.size());
+        for (int d = 0; d < 2; ++d) {
+            v[d].assign(K, 0.0);
+            if (weighted)
+                moments[d].reset(K);
+        }
+    }
+    void load(size_t, double) {}
+    void add(bool useTrue, size_t k, int spin, double weight) {
+        const size_t K = p->modulations.size();
+        const double* b = &(useTrue ? p->trueBasis : p->recoBasis)[k * K];
+        for (size_t m = 0; m < K; ++m)
+            v[useTrue][m] += spin * weight * b[m];
+        if (weighted)
+            moments[useTrue].add(b, weight);
+    }
+};
+
+template <typename Kin, bool Asimov, typename Sink>
+DatasetSums injectEvents(const PreparedBin& p, std::optional<double> A, double polarization, double scale, const SpinStream& stream,
+                         LoopBuffers& buffers, Sink& sink) {
+    if (A.has_value())
+        return injectEvents<Kin, Asimov>(p, FixedAsym{p, A.value()}, polarization, scale, stream, buffers, sink);
+    return injectEvents<Kin, Asimov>(p, TableAsym{p}, polarization, scale, stream, buffers, sink);
+}
+
+template <typename Kin, bool Asimov, typename Sink>
+DatasetSums injectEvents(const PreparedBin& p, const std::vector<std::optional<double>>& A, double polarization, double scale,
+                         const SpinStream& stream, LoopBuffers& buffers, Sink& sink) {
+    return injectEvents<Kin, Asimov>(p, ModulatedAsym{p, A}, polarization, scale, stream, buffers, sink);
+}
+
+template <bool Asimov, typename Amplitudes, typename Sink>
+DatasetSums injectEvents(const PreparedBin& p, const Amplitudes& A, double polarization, double scale, const SpinStream& stream,
+                         LoopBuffers& buffers, Sink& sink) {
+    if (p.fitsReco && p.fitsTrue)
+        return injectEvents<BothKin, Asimov>(p, A, polarization, scale, stream, buffers, sink);
+    if (p.fitsTrue)
+        return injectEvents<TrueKin, Asimov>(p, A, polarization, scale, stream, buffers, sink);
+    return injectEvents<RecoKin, Asimov>(p, A, polarization, scale, stream, buffers, sink);
+}
 
-        double true_depol1 = TrueDepol1.getVal();
-        double q_val     = std::sqrt(std::max(0.0, b_Q2));
-        double trueq_val = std::sqrt(std::max(0.0, b_TrueQ2));
-        double gamma_val = Gamma.getVal();
-        double y_val = Y.getVal();
-        double inner = (1.0 - y_val - 0.25 * y_val * y_val * gamma_val * gamma_val) / (1.0 + gamma_val * gamma_val);
-        if (inner < 0.0) inner = 0.0;
-        double sinTheta = gamma_val * std::sqrt(inner);
-        if (sinTheta > 1.0) sinTheta = 1.0;
-        double cosTheta = std::sqrt(std::max(0.0, 1.0 - sinTheta * sinTheta));
-        double phiS_val = PhiS.getVal();
-        double denom_ST = std::sqrt(std::max(1e-12, 1.0 - sinTheta*sinTheta*std::sin(phiS_val)*std::sin(phiS_val)));
-        double ST_val = cosTheta / denom_ST;
-        if (!std::isfinite(ST_val)) ST_val = 0.0;
-        S_T.setVal(ST_val);
-
-        double true_gamma_val = TrueGamma.getVal();
-        double true_y_val = TrueY.getVal();
-        double inner_true = (1.0 - true_y_val - 0.25 * true_y_val * true_y_val * true_gamma_val * true_gamma_val) / (1.0 + true_gamma_val * true_gamma_val);
-        if (inner_true < 0.0) inner_true = 0.0;
-        double sinTheta_true = true_gamma_val * std::sqrt(inner_true);
-        if (sinTheta_true > 1.0) sinTheta_true = 1.0;
-        double cosTheta_true = std::sqrt(std::max(0.0, 1.0 - sinTheta_true * sinTheta_true));
-        double truePhiS_val = TruePhiS.getVal();
-        double denom_TrueST = std::sqrt(std::max(1e-12, 1.0 - sinTheta_true*sinTheta_true*std::sin(truePhiS_val)*std::sin(truePhiS_val)));
-        double TrueST_val = cosTheta_true / denom_TrueST;
-        if (!std::isfinite(TrueST_val)) TrueST_val = 0.0;
-        TrueS_T.setVal(TrueST_val);
-        if(TrueST_val<0) LOG_DEBUG("Warning: TrueS_T < 0: " + std::to_string(TrueST_val) + " (cosTheta_true=" + std::to_string(cosTheta_true) + ", denom_TrueST=" + std::to_string(denom_TrueST) + ", sinTheta_true=" + std::to_string(sinTheta_true) + ", truePhiS_val=" + std::to_string(truePhiS_val) + ")");
-        // Determine asymmetry to inject
-        double trueAsymmetry = 0.0; // asymmetry corresponding to the actual physics process
-        double recoAsymmetry = 0.0; // asymmetry expected if we believed the reconstructed event to be true
-                                    // with more smearing, these two values are expected to differ
-        if(A_opt.has_value()) {
-            trueAsymmetry = A_opt.value();
-            recoAsymmetry = A_opt.value();
+// Binned likelihood of the spin given the analyzing-power cell: L = prod_j (1 + c_j A)^U_j (1 - c_j A)^D_j, c_j = P g_j,
+// maximized by Newton iterations. Cost scales with the number of cells, not with the number of events.
+// Returns (A, error) and the information lost to the binning relative to the per-event likelihood at the fitted A.
+std::pair<double, double> fitBinned(const PreparedBin& p, HistogramSink& h, bool useTrue, double polarization,
+                                    const LoopSums& sums, bool asimov, double& rawError, double& infoLoss, bool verbose) {
+    const std::vector<double>& up = h.up[useTrue];
+    const std::vector<double>& down = h.down[useTrue];
+    const std::vector<double>& cellG = useTrue ? p.trueCellG : p.recoCellG;
+    std::vector<double>& c = h.c;
+    c.resize(p.nCells);
+    for (int j = 0; j < p.nCells; ++j)
+        c[j] = polarization * cellG[j];
+    double A = 0.0, fitError = 0.0;
+    fitCellAmplitude(up.data(), down.data(), c.data(), c.size(), A, fitError);
+    rawError = fitError;
+
+    // Expected information of the cells and of the individual events, at the fitted A
+    const KinematicsBatch& kin = useTrue ? p.truth : p.reco;
+    const std::vector<unsigned char>& in = useTrue ? p.inTrue : p.inReco;
+    const std::vector<int>& cells = useTrue ? p.trueCell : p.recoCell;
+    double infoEvents = 0.0, infoCells = 0.0;
+    for (size_t k = 0; k < p.size(); ++k) {
+        if (!in[k])
+            continue;
+        const double ce = polarization * kin.S_T[k] * kin.Depol[k] * kin.SinPhi[k];
+        const double cj = polarization * cellG[cells[k]];
+        if (std::isfinite(ce)) {
+            infoEvents += ce * ce / std::max(1e-12, 1 - ce * ce * A * A);
+            infoCells += cj * cj / std::max(1e-12, 1 - cj * cj * A * A);
         }
-        else{
-            trueAsymmetry = table->lookupAUT(TrueX.getVal(), trueq_val, TrueZ.getVal(), TruePhPerp.getVal());
-            recoAsymmetry = table->lookupAUT(X.getVal(), q_val, Z.getVal(), PhPerp.getVal());
+    }
+    infoLoss = infoEvents > 0.0 ? 1.0 - infoCells / infoEvents : 0.0;
+
+    const double n_eff_mc = (sums.sumW * sums.sumW) / sums.sumW2;
+    const double error = asimov ? fitError : fitError * std::sqrt(n_eff_mc / sums.expected_events);
+    if (verbose) {
+        std::cout << "-------------------------------------------------------------------" << std::endl;
+        std::cout << " bool extract_with_true = " << useTrue << " (binned, " << p.nCells << " analyzing-power cells)" << std::endl;
+        std::cout << " ------------------------------------------------------------------" << std::endl;
+        std::cout << " Asymmetry Extracted = " << A << " +/- " << fitError << std::endl;
+        std::cout << " Asymmetry Extracted (w/ scaled EIC errors) = " << A << " +/- " << error << std::endl;
+        std::cout << " Information lost to binning = " << infoLoss << std::endl;
+        std::cout << "-------------------------------------------------------------------" << std::endl;
+    }
+    return std::make_pair(A, error);
+}
+
+// Unbinned fit over the super-events of one dataset: sum_j W_j log(1 + x_j A), maximized by Newton iterations,
+// with the closed-form error of weightedLikelihoodError from the summed weights and squared weights.
+// errorChange is the relative change of that error (at A = 0) from merging the events.
+std::pair<double, double> fitAggregated(AggregateSink& sink, bool useTrue, const LoopSums& sums, bool asimov, double& rawError,
+                                        int& superEvents, double& errorChange, bool verbose) {
+    std::vector<double>& W = sink.W;
+    std::vector<double>& W2 = sink.W2;
+    std::vector<double>& x = sink.x;
+    W.clear();
+    W2.clear();
+    x.clear();
+    for (const auto& c : sink.cells[useTrue]) {
+        if (c.sumW <= 0.0)
+            continue;
+        W.push_back(c.sumW);
+        W2.push_back(c.sumW2);
+        x.push_back(c.sumWX / c.sumW);
+    }
+    superEvents = static_cast<int>(W.size());
+    sink.none.assign(W.size(), 0.0);
+    double A = 0.0, hessianError = 0.0;
+    fitCellAmplitude(W.data(), sink.none.data(), x.data(), x.size(), A, hessianError);
+
+    double H = 0.0, B = 0.0, H0 = 0.0, B0 = 0.0;
+    for (size_t j = 0; j < x.size(); ++j) {
+        const double g = x[j] / (1 + x[j] * A);
+        H += W[j] * g * g;
+        B += W2[j] * g * g;
+        H0 += W[j] * x[j] * x[j];
+        B0 += W2[j] * x[j] * x[j];
+    }
+    auto sigma = [asimov](double h, double b) { return h > 0.0 ? (asimov ? 1.0 / std::sqrt(h) : std::sqrt(b) / h) : 0.0; };
+    rawError = sigma(H, B);
+    const double exact = sigma(sink.exactH[useTrue], sink.exactB[useTrue]);
+    errorChange = exact > 0.0 ? sigma(H0, B0) / exact - 1.0 : 0.0;
+
+    const double n_eff_mc = (sums.sumW * sums.sumW) / sums.sumW2;
+    const double error = asimov ? rawError : rawError * std::sqrt(n_eff_mc / sums.expected_events);
+    if (verbose) {
+        std::cout << "-------------------------------------------------------------------" << std::endl;
+        std::cout << " bool extract_with_true = " << useTrue << " (" << superEvents << " super-events from " << sums.selected
+                  << " events)" << std::endl;
+        std::cout << " ------------------------------------------------------------------" << std::endl;
+        std::cout << " Asymmetry Extracted = " << A << " +/- " << rawError << std::endl;
+        std::cout << " Asymmetry Extracted (w/ scaled EIC errors) = " << A << " +/- " << error << std::endl;
+        std::cout << " Relative error change from aggregation = " << errorChange << std::endl;
+        std::cout << "-------------------------------------------------------------------" << std::endl;
+    }
+    return std::make_pair(A, error);
+}
+
+// Amplitudes of every modulation from the spin moments of one dataset (see solveModulations): a KxK solve per
+// injection instead of a fit. Returns the first modulation; all of them and their correlations go to the outputs.
+std::pair<double, double> fitModulations(const PreparedBin& p, MomentSink& sink, bool useTrue, double polarization,
+                                         const LoopSums& sums, bool asimov, double& rawError,
+                                         std::vector<std::pair<double, double>>& results, std::vector<double>& correlation,
+                                         bool verbose) {
+    const ModulationMoments& moments = asimov ? sink.moments[useTrue] : (useTrue ? p.trueMoments : p.recoMoments);
+    const int K = moments.K;
+    std::vector<double>& A = sink.A;
+    std::vector<double>& cov = sink.cov;
+    if (!solveModulations(moments, sink.v[useTrue], polarization, A, cov))
+        LOG_WARN("Inject: singular modulation moments for bin (too few events?); amplitudes set to 0");
+    const double n_eff_mc = sums.sumW2 > 0 ? (sums.sumW * sums.sumW) / sums.sumW2 : 0.0;
+    const double errorScale = asimov || sums.expected_events <= 0 ? 1.0 : std::sqrt(n_eff_mc / sums.expected_events);
+    rawError = K > 0 ? std::sqrt(std::max(0.0, cov[0])) : 0.0;
+    results.clear();
+    results.reserve(K);
+    correlation.assign(static_cast<size_t>(K) * K, 0.0);
+    for (int i = 0; i < K; ++i) {
+        results.emplace_back(A[i], std::sqrt(std::max(0.0, cov[i * K + i])) * errorScale);
+        for (int j = 0; j < K; ++j) {
+            const double d = std::sqrt(std::max(0.0, cov[i * K + i] * cov[j * K + j]));
+            correlation[i * K + j] = d > 0 ? cov[i * K + j] / d : (i == j ? 1.0 : 0.0);
         }
-        double pPlus = 0.5 * (1 + TrueST_val * true_depol1 * trueAsymmetry * std::sin(TruePhiH.getVal() + TruePhiS.getVal()));
-        Spin_idx.setVal(rng.Rndm() < pPlus ? 1 : -1);
-        if(rng.Rndm() > targetPolarization){
-            // Set Spin_idx to -1 or 1 with 50/50 chance
-            Spin_idx.setVal(rng.Rndm() < 0.5 ? 1 : -1);
+    }
+    if (verbose) {
+        std::cout << "-------------------------------------------------------------------" << std::endl;
+        std::cout << " bool extract_with_true = " << useTrue << " (" << K << " modulations, moment solution)" << std::endl;
+        std::cout << " ------------------------------------------------------------------" << std::endl;
+        for (int i = 0; i < K; ++i)
+            std::cout << " " << p.modulations[i].name() << " amplitude extracted (w/ scaled EIC errors) = " << results[i].first << " +/- "
+                      << results[i].second << std::endl;
+        std::cout << "-------------------------------------------------------------------" << std::endl;
+    }
+    return results.empty() ? std::make_pair(0.0, 0.0) : results.front();
+}
+
+// Error of the weighted likelihood sum_e w_e log(1 + x_e A) at the fitted A, in closed form: with the per-event
+// score g_e = x_e / (1 + x_e A), H = sum w g^2 and the sandwich variance is H^-1 (sum w^2 g^2) H^-1. This is what
+// SumW2Error computes with a second HESSE pass. Asimov weights are expected yields, not sampling weights, so
+// their variance is the inverse Hessian.
+double weightedLikelihoodError(const std::vector<double>& x, const std::vector<double>& w, double A, bool asimov) {
+    auto wg2 = [&](size_t e) {
+        const double g = x[e] / (1 + x[e] * A);
+        return w[e] * g * g;
+    };
+    const double H = pairwiseSum(0, x.size(), wg2);
+    const double B = pairwiseSum(0, x.size(), [&](size_t e) { return w[e] * wg2(e); });
+    if (!(H > 0.0))
+        return 0.0;
+    return asimov ? 1.0 / std::sqrt(H) : std::sqrt(B) / H;
+}
+
+// Bootstrap replicas: Poisson(1) counts keyed by (seed, bin, entry, replica) on their own random streams
+constexpr uint32_t kBootstrapStream = 0x8000;
+constexpr int kReplicaBlock = 63; // replicas fitted together (a multiple of the 3 uniforms per draw)
+
+// Poisson(1) variate from a uniform, by inversion of the cumulative distribution
+inline uint8_t poissonOne(double u) {
+    static const std::array<double, 12> cdf = [] {
+        std::array<double, 12> c{};
+        double term = std::exp(-1.0), sum = 0.0;
+        for (size_t k = 0; k < c.size(); ++k) {
+            sum += term;
+            c[k] = sum;
+            term /= static_cast<double>(k + 1);
         }
+        return c;
+    }();
+    uint8_t k = 0;
+    while (k < cdf.size() && u > cdf[k])
+        ++k;
+    return k;
+}
 
-        dataUpdate.add(obs);
-        expected_events+=TotalWeight.getVal();
-        sumW += Weight.getVal();
-        sumW2 += Weight.getVal()*Weight.getVal();
-        sumTrueAsymW += Weight.getVal()*trueAsymmetry;
-        sumRecoAsymW += Weight.getVal()*recoAsymmetry;
+// Maximum-likelihood fits of sum_e c_er log(1 + x_e A_r) for a block of R replicas, c_er ~ Poisson(1). The counts
+// are drawn once (event-major), then every Newton iteration is one streaming pass over the events that updates
+// the derivatives of all replicas. Errors are the inverse Hessians of the replicas at their final amplitudes.
+// Replicas that did not converge or ended at the +-0.999 clamp get a NaN error.
+void fitReplicas(const std::vector<double>& x, const std::vector<Long64_t>& entries, const SpinStream& replicaStream, int first,
+                 int R, std::vector<double>& A, std::vector<double>& error) {
+    const size_t n = x.size();
+    std::vector<uint8_t> counts(n * R);
+    for (size_t e = 0; e < n; ++e) {
+        uint8_t* c = &counts[e * R];
+        for (int r = 0; r < R; r += 3) {
+            SpinStream s = replicaStream;
+            s.injection = static_cast<uint32_t>((first + r) / 3);
+            const auto u = s.draw(static_cast<uint64_t>(entries[e]));
+            for (int t = 0; t < 3 && r + t < R; ++t)
+                c[r + t] = poissonOne(u[t]);
+        }
     }
-    std::cout << "[Inject::injectExtractForBin] Selected " << selected_count << " events for injection (after tree loop)." << std::endl;
 
-    // Get effective MC events
-    double n_eff_mc = (sumW*sumW)/sumW2;
-    // Save number of injection data points to bin
-    bin.setEvents(dataUpdate.numEntries());
-    bin.setExpectedEvents(static_cast<int>(std::round(expected_events)));
+    A.assign(R, 0.0);
+    std::vector<double> d1(R), d2(R);
+    // First and second derivatives of every replica at the current amplitudes
+    auto derivatives = [&]() {
+        std::fill(d1.begin(), d1.end(), 0.0);
+        std::fill(d2.begin(), d2.end(), 0.0);
+        for (size_t e = 0; e < n; ++e) {
+            const double xe = x[e];
+            const uint8_t* c = &counts[e * R];
+            for (int r = 0; r < R; ++r) {
+                const double g = xe / (1 + xe * A[r]);
+                const double cg = c[r] * g;
+                d1[r] += cg;
+                d2[r] += cg * g;
+            }
+        }
+    };
+    std::vector<char> converged(R, 0);
+    for (int it = 0; it < 50; ++it) {
+        derivatives();
+        bool all = true;
+        for (int r = 0; r < R; ++r) {
+            if (!(d2[r] > 0.0)) {
+                all &= converged[r] != 0;
+                continue;
+            }
+            const double step = d1[r] / d2[r];
+            A[r] = std::clamp(A[r] + step, -0.999, 0.999);
+            if (std::abs(step) < 1e-10)
+                converged[r] = 1;
+            all &= converged[r] != 0;
+        }
+        if (all)
+            break;
+    }
+    derivatives();
+    error.assign(R, 0.0);
+    for (int r = 0; r < R; ++r) {
+        const bool valid = converged[r] && std::abs(A[r]) < 0.999 && d2[r] > 0.0;
+        error[r] = valid ? 1.0 / std::sqrt(d2[r]) : std::numeric_limits<double>::quiet_NaN();
+    }
+}
 
+// Fits the asymmetry with the true or reco kinematics; the error is scaled to the expected EIC yield.
+// RooFit only minimizes (no HESSE pass) unless rooFitErrors asks for its SumW2Error errors, kept for validation.
+// Asimov datasets are weighted by expected yields, so their plain (Hessian) error is already at the EIC yield.
+std::pair<double, double> fitAsymmetry(Observables& o, RooDataSet& data, const DataSetSink& sink, const LoopSums& sums, bool useTrue,
+                                       bool asimov, bool rooFitErrors, double& rawError, bool verbose) {
+    std::lock_guard<std::mutex> lock(rooFitMutex);
+    // Get effective MC events
+    const double n_eff_mc = (sums.sumW * sums.sumW) / sums.sumW2;
     RooRealVar A_fit("A", "A", 0.0, -1.0, 1.0);
-    // Determine which PhiH/PhiS to use for extraction
     double val = 0.0;
-    double error = 0.0;
-    if (extract_with_true) {
-        RooGenericPdf model("model", "1 + TrueS_T * TrueDepol1 * tPol * Spin_idx * A * sin(TruePhiH+TruePhiS)", RooArgList(TrueS_T, TruePhiH, TruePhiS, TrueDepol1, tPol, Spin_idx, A_fit));
-        RooFitResult* fitResult = model.fitTo(dataUpdate, Save(), PrintLevel(-1), SumW2Error(kTRUE));
+    if (useTrue) {
+        RooGenericPdf model("model", "1 + TrueS_T * TrueDepol1 * tPol * Spin_idx * A * sin(TruePhiH+TruePhiS)", RooArgList(o.TrueS_T, o.TruePhiH, o.TruePhiS, o.TrueDepol1, o.tPol, o.Spin_idx, A_fit));
+        RooFitResult* fitResult = rooFitErrors ? model.fitTo(data, Save(), PrintLevel(-1), SumW2Error(!asimov))
+                                               : model.fitTo(data, Save(), PrintLevel(-1), SumW2Error(false), Hesse(false));
         val = A_fit.getVal();
-        error = A_fit.getError() * std::sqrt(n_eff_mc/expected_events);
         delete fitResult;
     } else {
-        RooGenericPdf model("model", "1 + S_T * Depol1 * tPol * Spin_idx * A * sin(PhiH+PhiS)", RooArgList(S_T, PhiH, PhiS, Depol1, tPol, Spin_idx, A_fit));
-        RooFitResult* fitResult = model.fitTo(dataUpdate, Save(), PrintLevel(-1), SumW2Error(kTRUE));
+        RooGenericPdf model("model", "1 + S_T * Depol1 * tPol * Spin_idx * A * sin(PhiH+PhiS)", RooArgList(o.S_T, o.PhiH, o.PhiS, o.Depol1, o.tPol, o.Spin_idx, A_fit));
+        RooFitResult* fitResult = rooFitErrors ? model.fitTo(data, Save(), PrintLevel(-1), SumW2Error(!asimov))
+                                               : model.fitTo(data, Save(), PrintLevel(-1), SumW2Error(false), Hesse(false));
         val = A_fit.getVal();
-        error = A_fit.getError() * std::sqrt(n_eff_mc/expected_events);
         delete fitResult;
     }
-    // Get effective true injected asymmetry
-    double eff_inj_tasym = sumTrueAsymW/sumW;
-    // Get effective reco asymmetry
-    double eff_inj_rasym = sumRecoAsymW/sumW;
-
-    std::cout << "======================== Asymmetry Results ========================\n" << std::endl;
-    std::cout << "-------------------------------------------------------------------" << std::endl;
-    std::cout << " bool extract_with_true = " << extract_with_true << std::endl;
-    std::cout << " ------------------------------------------------------------------" << std::endl;
-    std::cout << " Asymmetry Extracted = " << val << " +/- " << A_fit.getError() << std::endl;
-    std::cout << " Asymmetry Extracted (w/ scaled EIC errors) = " << val << " +/- " << error << std::endl;
-    std::cout << " Effective Truth Injected Asymmetry = " << eff_inj_tasym << std::endl;
-    std::cout << " Effective Reco Injected Asymmetry = " << eff_inj_rasym << std::endl;
-    std::cout << "-------------------------------------------------------------------" << std::endl;
+    rawError = rooFitErrors ? A_fit.getError() : weightedLikelihoodError(sink.scores.x[useTrue], sink.scores.w[useTrue], val, asimov);
+    const double error = asimov ? rawError : rawError * std::sqrt(n_eff_mc/sums.expected_events);
+
+    if (verbose) {
+        std::cout << "-------------------------------------------------------------------" << std::endl;
+        std::cout << " bool extract_with_true = " << useTrue << std::endl;
+        std::cout << " ------------------------------------------------------------------" << std::endl;
+        std::cout << " Asymmetry Extracted = " << val << " +/- " << rawError << std::endl;
+        std::cout << " Asymmetry Extracted (w/ scaled EIC errors) = " << val << " +/- " << error << std::endl;
+        // Get effective true injected asymmetry
+        std::cout << " Effective Truth Injected Asymmetry = " << sums.sumTrueAsymW/sums.sumW << std::endl;
+        if (!useTrue) {
+            // Effective reco asymmetry
+            std::cout << " Effective Reco Injected Asymmetry = " << sums.sumRecoAsymW/sums.sumW << std::endl;
+        }
+        std::cout << "-------------------------------------------------------------------" << std::endl;
+    }
     return std::make_pair(val, error);
 }
+
+} // namespace
+
+// Everything an injection needs beyond the prepared bin, kept for the next one: the loop buffers, one sink per
+// fit mode and, for RooFit fits, the observables and datasets of the last bin and polarization
+struct Inject::Scratch {
+    LoopBuffers buffers;
+    ScoreSink scores;
+    HistogramSink histograms;
+    MomentSink moments;
+    AggregateSink aggregate;
+    std::unique_ptr<Observables> observables;
+    std::unique_ptr<RooDataSet> recoData, trueData;
+    const Bin* observablesBin = nullptr;
+    double observablesPolarization = 0.0;
+
+    // Observables of a bin and emptied datasets over them; rebuilt only when the bin or the polarization changes
+    Observables& datasets(const Bin& bin, double polarization) {
+        if (!observables || observablesBin != &bin || observablesPolarization != polarization) {
+            recoData.reset();
+            trueData.reset();
+            observables = std::make_unique<Observables>(bin, polarization);
+            recoData = std::make_unique<RooDataSet>("recoData", "reco-binned data with updated spin", observables->obs,
+                                                    WeightVar(observables->TotalWeight));
+            trueData = std::make_unique<RooDataSet>("trueData", "true-binned data with updated spin", observables->obs,
+                                                    WeightVar(observables->TotalWeight));
+            observablesBin = &bin;
+            observablesPolarization = polarization;
+        } else {
+            recoData->reset();
+            trueData->reset();
+        }
+        return *observables;
+    }
+};
+
+Inject::Inject(EventSource* source, const Table* table, double scale, double targetPolarization)
+    : source(source)
+    , table(table)
+    , m_scale(scale)
+    , targetPolarization(targetPolarization)
+    , scratch(std::make_unique<Scratch>()) {}
+Inject::~Inject() {
+    // The scratch holds RooFit objects
+    std::lock_guard<std::mutex> lock(rooFitMutex);
+    scratch.reset();
+}
+
+void Inject::setBinnedFit(int nCells) {
+    if (nCells != 0 && nCells < 2)
+        throw std::invalid_argument("Inject: a binned fit needs at least 2 cells");
+    binnedCells = nCells;
+}
+
+void Inject::setAggregation(double tolerance) {
+    if (tolerance != 0.0 && !(tolerance >= 1e-6 && tolerance <= 1.0))
+        throw std::invalid_argument("Inject: aggregation tolerance must be 0 or in [1e-6, 1]");
+    aggregationTolerance = tolerance;
+}
+
+PreparedBin Inject::prepare(const Bin& bin, bool fitsReco, bool fitsTrue, bool withTable) {
+    PreparedBin p;
+    p.bin = &bin;
+    p.fitsReco = fitsReco;
+    p.fitsTrue = fitsTrue;
+    if (!source) {
+        std::cerr << "[Inject::prepare] Error: EventSource pointer is null." << std::endl;
+        return p;
+    }
+    const BinBounds bounds(bin);
+    // With a selection bitmap only the pre-selected entries are visited; either way only entries of the event range
+    Long64_t nentries = selection ? static_cast<Long64_t>(selection->cardinality())
+                                  : static_cast<Long64_t>(std::ceil(range.count(source->getEntries())));
+    // Prepare progress bar printing
+    const Long64_t progress_steps = std::min<Long64_t>(100, std::max<Long64_t>(1, nentries/100));
+    Long64_t next_progress = progress_steps;
+    auto processEntry = [&](Long64_t i, Long64_t entry) {
+        const Event& ev = source->getEntry(entry);
+        // Update progress bar occasionally
+        if (verbose && (i >= next_progress || i == 0 || i == nentries-1)) {
+            int percent = static_cast<int>(100.0 * (i+1) / std::max<Long64_t>(1, nentries));
+            std::cout << "\r[" << percent << "%] Processing entry " << (i+1) << " / " << nentries << std::flush;
+            next_progress = i + progress_steps;
+            if (i == nentries-1) std::cout << std::endl;
+        }
+        const bool reco = fitsReco && bounds.contains(ev.X, ev.Q2, ev.Z, ev.PhPerp);
+        const bool truth = fitsTrue && bounds.contains(ev.TrueX, ev.TrueQ2, ev.TrueZ, ev.TruePhPerp);
+        if (reco || truth) {
+            p.events.push_back(ev);
+            p.entries.push_back(entry);
+            p.inReco.push_back(reco);
+            p.inTrue.push_back(truth);
+        }
+    };
+    Long64_t i = 0;
+    if (selection) {
+        selection->forEach([&](uint64_t entry) {
+            if (range.contains(static_cast<Long64_t>(entry)))
+                processEntry(i++, static_cast<Long64_t>(entry));
+        });
+    } else {
+        range.forEach(0, source->getEntries(), [&](Long64_t entry) { processEntry(i++, entry); });
+    }
+    const size_t n = p.size();
+    if (verbose)
+        std::cout << "[Inject::prepare] Selected " << n << " events for injection (after tree loop)." << std::endl;
+
+    // Spin-transfer quantities in vectorized batches: true kinematics drive the injection, reco ones
+    // are only needed when fitting reco kinematics
+    p.truth.reserve(n);
+    for (const Event& ev : p.events)
+        p.truth.push(ev.TrueX, ev.TrueQ2, ev.TrueY, ev.TruePhiH, ev.TruePhiS);
+    p.truth.compute();
+    for (size_t k = 0; k < n; ++k) {
+        if (p.truth.S_T[k] < 0)
+            LOG_DEBUG("Warning: TrueS_T < 0: " + std::to_string(p.truth.S_T[k]) + " (TrueGamma=" + std::to_string(p.truth.Gamma[k]) +
+                      ", truePhiS_val=" + std::to_string(p.events[k].TruePhiS) + ")");
+    }
+    if (fitsReco) {
+        p.reco.reserve(n);
+        for (const Event& ev : p.events)
+            p.reco.push(ev.X, ev.Q2, ev.Y, ev.PhiH, ev.PhiS);
+        p.reco.compute();
+    }
+
+    // Analyzing-power cells of the binned fit: uniform in g = S_T Depol sin(PhiH + PhiS) over [-1, 1], with the
+    // mean g of the events in each cell. Spins change between injections, the cells do not.
+    if (binnedCells > 0) {
+        p.nCells = binnedCells;
+        auto assignCells = [&](const KinematicsBatch& kin, const std::vector<unsigned char>& in, std::vector<int>& cells,
+                               std::vector<double>& cellG) {
+            cells.assign(n, 0);
+            cellG.assign(p.nCells, 0.0);
+            std::vector<double> count(p.nCells, 0.0);
+            for (size_t k = 0; k < n; ++k) {
+                double g = kin.S_T[k] * kin.Depol[k] * kin.SinPhi[k];
+                if (!std::isfinite(g))
+                    g = 0.0;
+                const int cell = std::clamp(static_cast<int>((g + 1.0) * 0.5 * p.nCells), 0, p.nCells - 1);
+                cells[k] = cell;
+                if (in[k]) {
+                    cellG[cell] += g;
+                    count[cell] += 1.0;
+                }
+            }
+            for (int j = 0; j < p.nCells; ++j)
+                cellG[j] = count[j] > 0 ? cellG[j] / count[j] : 0.0;
+        };
+        if (fitsReco)
+            assignCells(p.reco, p.inReco, p.recoCell, p.recoCellG);
+        if (fitsTrue)
+            assignCells(p.truth, p.inTrue, p.trueCell, p.trueCellG);
+    }
+
+    // Modulation basis of every event and its moments over each dataset, for the multi-modulation extraction
+    if (!modulations.empty()) {
+        p.modulations = modulations;
+        const size_t K = modulations.size();
+        auto assignBasis = [&](const KinematicsBatch& kin, const std::vector<unsigned char>& in, std::vector<double>& basis,
+                               ModulationMoments& moments) {
+            basis.assign(n * K, 0.0);
+            moments.reset(static_cast<int>(K));
+            for (size_t k = 0; k < n; ++k) {
+                double* b = &basis[k * K];
+                for (size_t m = 0; m < K; ++m) {
+                    const double d = modulations[m].usesDepolarization() ? kin.Depol[k] : 1.0;
+                    const double v = kin.S_T[k] * d * modulations[m].f(kin.PhiH[k], kin.PhiS[k]);
+                    b[m] = std::isfinite(v) ? v : 0.0;
+                }
+                if (in[k])
+                    moments.add(b, 1.0);
+            }
+        };
+        // The spins are always drawn from the true basis
+        assignBasis(p.truth, p.inTrue, p.trueBasis, p.trueMoments);
+        if (fitsReco)
+            assignBasis(p.reco, p.inReco, p.recoBasis, p.recoMoments);
+    }
+
+    // Table asymmetries, from the per-entry cache when one is set
+    if (withTable && table) {
+        p.trueAUT.resize(n);
+        p.recoAUT.resize(n);
+        for (size_t k = 0; k < n; ++k) {
+            const Event& ev = p.events[k];
+            if (autCache) {
+                const AUTCache::Value v = autCache->get(p.entries[k], ev);
+                p.trueAUT[k] = v.trueAUT;
+                p.recoAUT[k] = v.recoAUT;
+            } else {
+                p.trueAUT[k] = table->lookupAUT(ev.TrueX, std::sqrt(std::max(0.0, ev.TrueQ2)), ev.TrueZ, ev.TruePhPerp);
+                p.recoAUT[k] = table->lookupAUT(ev.X, std::sqrt(std::max(0.0, ev.Q2)), ev.Z, ev.PhPerp);
+            }
+        }
+    }
+    return p;
+}
+
+bool Inject::Point::usesTable() const {
+    if (modulationA.empty())
+        return !A.has_value();
+    for (const auto& a : modulationA)
+        if (!a.has_value())
+            return true;
+    return false;
+}
+
+Inject::DualResult Inject::injectExtract(const PreparedBin& prep, const Point& point, int injection, uint32_t stream) const {
+    return runToy(prep, point, injection, stream, false);
+}
+
+Inject::DualResult Inject::injectExtractAsimov(const PreparedBin& prep, const Point& point) const {
+    return runToy(prep, point, 0, 0, true);
+}
+
+std::vector<Inject::DualResult> Inject::bootstrap(const PreparedBin& prep, const Point& point, int replicas, uint32_t stream) const {
+    std::vector<DualResult> res(std::max(0, replicas));
+    if (!prep.bin || replicas <= 0)
+        return res;
+    if (!point.A.has_value() && prep.trueAUT.size() != prep.size()) {
+        LOG_ERROR("Inject::bootstrap: no injected amplitude and the bin was not prepared with the table");
+        return res;
+    }
+
+    // One injection, then the replicas reweight its events
+    ScoreSink& sink = scratch->scores;
+    sink.begin(prep, point.polarization);
+    const DatasetSums sums =
+        injectEvents<false>(prep, point.A, point.polarization, m_scale, SpinStream{seed, binId, 0, stream}, scratch->buffers, sink);
+    const SpinStream replicaStream{seed, binId, 0, kBootstrapStream | (stream & 0x7fff)};
+    for (bool useTrue : {false, true}) {
+        if (useTrue ? !prep.fitsTrue : !prep.fitsReco)
+            continue;
+        const LoopSums& s = useTrue ? sums.truth : sums.reco;
+        const double n_eff_mc = s.sumW2 > 0 ? (s.sumW * s.sumW) / s.sumW2 : 0.0;
+        const double errorScale = s.expected_events > 0 ? std::sqrt(n_eff_mc / s.expected_events) : 1.0;
+        std::vector<double> A, error;
+        int invalid = 0;
+        for (int first = 0; first < replicas; first += kReplicaBlock) {
+            const int R = std::min(kReplicaBlock, replicas - first);
+            fitReplicas(sink.x[useTrue], sink.entry[useTrue], replicaStream, first, R, A, error);
+            for (int r = 0; r < R; ++r) {
+                DualResult& d = res[first + r];
+                (useTrue ? d.truth : d.reco) = std::make_pair(A[r], error[r] * errorScale);
+                (useTrue ? d.trueRawError : d.recoRawError) = error[r];
+                invalid += std::isnan(error[r]);
+            }
+        }
+        if (invalid > 0)
+            LOG_WARN("Inject::bootstrap: " + std::to_string(invalid) + " of " + std::to_string(replicas) + (useTrue ? " true" : " reco") +
+                     " replica fits did not converge or hit the amplitude bound; they are left out of the replica spread");
+    }
+    for (DualResult& d : res) {
+        d.recoEvents = static_cast<int>(sums.reco.selected);
+        d.trueEvents = static_cast<int>(sums.truth.selected);
+        d.recoExpectedEvents = sums.reco.expected_events;
+        d.trueExpectedEvents = sums.truth.expected_events;
+    }
+    LOG_INFO("Inject::bootstrap: " + std::to_string(replicas) + " Poisson replicas of one injection fitted");
+    return res;
+}
+
+Inject::DualResult Inject::runToy(const PreparedBin& prep, const Point& point, int injection, uint32_t stream, bool asimov) const {
+    DualResult res;
+    if (!prep.bin)
+        return res;
+    if (point.usesTable() && prep.trueAUT.size() != prep.size()) {
+        LOG_ERROR("Inject::injectExtract: no injected amplitude and the bin was not prepared with the table");
+        return res;
+    }
+
+    const SpinStream spins{seed, binId, static_cast<uint32_t>(injection), stream};
+    LoopBuffers& buffers = scratch->buffers;
+    auto fillResult = [&](const DatasetSums& sums) {
+        res.recoEvents = static_cast<int>(sums.reco.selected);
+        res.trueEvents = static_cast<int>(sums.truth.selected);
+        res.recoExpectedEvents = sums.reco.expected_events;
+        res.trueExpectedEvents = sums.truth.expected_events;
+    };
+
+    if (!prep.modulations.empty()) {
+        // Multi-modulation mode: only the spin moments are accumulated, the basis moments come with the bin
+        if (point.modulationA.size() != prep.modulations.size()) {
+            LOG_ERROR("Inject::injectExtract: expected one injected amplitude per prepared modulation");
+            return res;
+        }
+        MomentSink& sink = scratch->moments;
+        sink.begin(prep, asimov);
+        const DatasetSums sums = asimov ? injectEvents<true>(prep, point.modulationA, point.polarization, m_scale, spins, buffers, sink)
+                                        : injectEvents<false>(prep, point.modulationA, point.polarization, m_scale, spins, buffers, sink);
+        fillResult(sums);
+        if (verbose)
+            std::cout << "======================== Asymmetry Results ========================\n" << std::endl;
+        if (prep.fitsReco)
+            res.reco = fitModulations(prep, sink, false, point.polarization, sums.reco, asimov, res.recoRawError, res.recoModulations,
+                                      res.recoModulationCorrelation, verbose);
+        if (prep.fitsTrue)
+            res.truth = fitModulations(prep, sink, true, point.polarization, sums.truth, asimov, res.trueRawError, res.trueModulations,
+                                       res.trueModulationCorrelation, verbose);
+        return res;
+    }
+
+    if (prep.nCells > 0) {
+        // Binned mode: no RooDataSet, the spins are histogrammed in the prepared analyzing-power cells
+        HistogramSink& sink = scratch->histograms;
+        sink.begin(prep);
+        const DatasetSums sums = asimov ? injectEvents<true>(prep, point.A, point.polarization, m_scale, spins, buffers, sink)
+                                        : injectEvents<false>(prep, point.A, point.polarization, m_scale, spins, buffers, sink);
+        fillResult(sums);
+        if (verbose)
+            std::cout << "======================== Asymmetry Results ========================\n" << std::endl;
+        if (prep.fitsReco)
+            res.reco = fitBinned(prep, sink, false, point.polarization, sums.reco, asimov, res.recoRawError, res.recoBinningInfoLoss, verbose);
+        if (prep.fitsTrue)
+            res.truth = fitBinned(prep, sink, true, point.polarization, sums.truth, asimov, res.trueRawError, res.trueBinningInfoLoss, verbose);
+        return res;
+    }
+
+    if (aggregationTolerance > 0.0) {
+        // Aggregated mode: no RooDataSet, the events are merged into super-events while they are injected
+        AggregateSink& sink = scratch->aggregate;
+        sink.begin(prep, point.polarization, aggregationTolerance);
+        const DatasetSums sums = asimov ? injectEvents<true>(prep, point.A, point.polarization, m_scale, spins, buffers, sink)
+                                        : injectEvents<false>(prep, point.A, point.polarization, m_scale, spins, buffers, sink);
+        fillResult(sums);
+        if (verbose)
+            std::cout << "======================== Asymmetry Results ========================\n" << std::endl;
+        if (prep.fitsReco)
+            res.reco = fitAggregated(sink, false, sums.reco, asimov, res.recoRawError, res.recoSuperEvents, res.recoAggregationErrorChange,
+                                     verbose);
+        if (prep.fitsTrue)
+            res.truth = fitAggregated(sink, true, sums.truth, asimov, res.trueRawError, res.trueSuperEvents, res.trueAggregationErrorChange,
+                                      verbose);
+        return res;
+    }
+
+    // RooFit's own allocations (the fit, the dataset stores) remain; the observables and datasets are reused
+    Observables& o = [&]() -> Observables& {
+        std::lock_guard<std::mutex> lock(rooFitMutex);
+        return scratch->datasets(*prep.bin, point.polarization);
+    }();
+    RooDataSet& recoData = *scratch->recoData;
+    RooDataSet& trueData = *scratch->trueData;
+    scratch->scores.begin(prep, point.polarization);
+
+    // The loop variant is picked once per toy
+    DataSetSink sink{prep, o, &recoData, &trueData, scratch->scores};
+    const DatasetSums sums = asimov ? injectEvents<true>(prep, point.A, point.polarization, m_scale, spins, buffers, sink)
+                                    : injectEvents<false>(prep, point.A, point.polarization, m_scale, spins, buffers, sink);
+    fillResult(sums);
+
+    if (verbose)
+        std::cout << "======================== Asymmetry Results ========================\n" << std::endl;
+    if (prep.fitsReco)
+        res.reco = fitAsymmetry(o, recoData, sink, sums.reco, false, asimov, rooFitErrors, res.recoRawError, verbose);
+    if (prep.fitsTrue)
+        res.truth = fitAsymmetry(o, trueData, sink, sums.truth, true, asimov, rooFitErrors, res.trueRawError, verbose);
+    return res;
+}
+
+std::pair<double, double> Inject::injectExtractForBin(const Bin& bin, bool extract_with_true, std::optional<double> A_opt, int injection) {
+    const PreparedBin prep = prepare(bin, !extract_with_true, extract_with_true, !A_opt.has_value());
+    const DualResult res = injectExtract(prep, Point{A_opt, targetPolarization}, injection);
+    // Save number of injection data points to bin
+    bin.setEvents(extract_with_true ? res.trueEvents : res.recoEvents);
+    bin.setExpectedEvents(static_cast<int>(std::round(extract_with_true ? res.trueExpectedEvents : res.recoExpectedEvents)));
+    return extract_with_true ? res.truth : res.reco;
+}
+
+Inject::DualResult Inject::injectExtractBothForBin(const Bin& bin, std::optional<double> A_opt, int injection) {
+    // One pass over the input and one spin per event fill both datasets
+    const PreparedBin prep = prepare(bin, true, true, !A_opt.has_value());
+    return injectExtract(prep, Point{A_opt, targetPolarization}, injection);
+}
@@ -1,16 +1,51 @@
 #include "InjectionProject.h"
+#include "TaskScheduler.h"
+#include "Utility.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <deque>
 #include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
 #include <yaml-cpp/yaml.h>
 #include <iostream>
 
-InjectionProject::InjectionProject(const std::string& filename, TTree* tree, const Table* table, double scale, const Grid* grid, double targetPolarization, const std::string& outDir, const std::string& outFilename)
-    : filename(filename), tree(tree), table(table), scale(scale), grid(grid), targetPolarization(targetPolarization), outDir(outDir), outFilename(outFilename) {
+namespace {
+// Mean and sample standard deviation
+std::pair<double, double> meanStddev(const std::vector<double>& vals) {
+    double mean = 0.0;
+    for (double v : vals) mean += v;
+    mean /= std::max(1, static_cast<int>(vals.size()));
+    double var = 0.0;
+    for (double v : vals) var += (v - mean) * (v - mean);
+    double stddev = vals.size() > 1 ? std::sqrt(var / (vals.size() - 1)) : 0.0;
+    return std::make_pair(mean, stddev);
+}
+
+// Minimum time between two rewrites of the summary while jobs finish
+constexpr auto kSummaryInterval = std::chrono::seconds(30);
+
+// The YAML maps of the finished jobs, in job order
+std::vector<std::string> finishedYaml(const std::vector<std::string>& jobYaml, const std::vector<char>& finished) {
+    std::vector<std::string> done;
+    for (size_t j = 0; j < jobYaml.size(); ++j)
+        if (finished[j])
+            done.push_back(jobYaml[j]);
+    return done;
+}
+} // namespace
+
+InjectionProject::InjectionProject(const std::string& filename, EventSource* source, const Table* table, double scale, const Grid* grid, double targetPolarization, const std::string& outDir, const std::string& outFilename)
+    : filename(filename), source(source), table(table), scale(scale), grid(grid), targetPolarization(targetPolarization), outDir(outDir), outFilename(outFilename) {
         // Create outprefix
-        std::string rootStem = std::filesystem::path(filename).stem().string();
+        std::string rootStem = util::inputStem(filename);
         if (!outFilename.empty()) {
             outPrefix = std::filesystem::path(outDir) / outFilename;
         } else {
-            outPrefix = std::filesystem::path(outDir) / (std::string("injection_") + rootStem + "_" + tree->GetName() + ".yaml");
+            outPrefix = std::filesystem::path(outDir) / (std::string("injection_") + rootStem + "_" + source->getName() + ".yaml");
         }
     }
 
@@ -24,71 +59,587 @@ bool InjectionProject::run() {
         return false;
     }
     const auto& bins = grid->getBins();
-    YAML::Emitter out;
-    out << YAML::BeginMap;
-    out << YAML::Key << "jobs" << YAML::Value << YAML::BeginSeq;
-    int jobIdx = 0;
-    for (const auto& job : jobs) {
+    if (!autCache && table) {
+        autCache = std::make_unique<AUTCache>(table);
+        if (!autCacheFile.empty() && std::filesystem::exists(autCacheFile))
+            autCache->load(autCacheFile, source->getEntries());
+    }
+    // Finished jobs are appended to a journal, one record per line, and the summary is rewritten
+    // atomically after each of them. A rerun with the same jobs reuses the journal records.
+    const std::string journalName = outPrefix + ".journal";
+    std::map<std::string, std::deque<std::string>> completed;
+    if (!overwrite && !resume && std::filesystem::exists(journalName) && std::filesystem::file_size(journalName) > 0) {
+        LOG_ERROR("InjectionProject: journal " + journalName + " exists; pass --resume to reuse its jobs or --overwrite to start over");
+        return false;
+    }
+    if (resume && !overwrite) {
+        std::ifstream in(journalName);
+        std::string line;
+        int nRecords = 0;
+        while (std::getline(in, line)) {
+            try {
+                const YAML::Node record = YAML::Load(line);
+                completed[record["key"].as<std::string>()].push_back(record["job"].as<std::string>());
+                ++nRecords;
+            } catch (const std::exception&) {
+                // Record cut short by an interrupted run
+                LOG_WARN("InjectionProject: ignoring incomplete journal record in " + journalName);
+            }
+        }
+        if (nRecords > 0)
+            LOG_INFO("InjectionProject: resuming from " + std::to_string(nRecords) + " journal records in " + journalName);
+    }
+    std::ofstream journal(journalName, overwrite ? std::ios::trunc : std::ios::app);
+    if (!journal.is_open()) {
+        LOG_ERROR("InjectionProject: could not open journal " + journalName);
+        return false;
+    }
+    // Journal key of every job
+    const std::string project = projectKey();
+    std::vector<std::string> keys(jobs.size());
+    // YAML map of every job, in job order (empty until the job finished)
+    std::vector<std::string> jobYaml(jobs.size());
+    std::vector<char> finished(jobs.size(), 0);
+    std::mutex finishMutex;
+    std::atomic<bool> ok{true};
+    size_t nFinished = 0;
+    auto lastSummary = std::chrono::steady_clock::now();
+    // Appends a finished job to the journal
+    auto finish = [&](size_t j, const std::string& yaml) {
+        std::lock_guard<std::mutex> lock(finishMutex);
+        jobYaml[j] = yaml;
+        finished[j] = 1;
+        YAML::Emitter record;
+        record << YAML::Flow << YAML::BeginMap;
+        record << YAML::Key << "key" << YAML::Value << YAML::DoubleQuoted << keys[j];
+        record << YAML::Key << "job" << YAML::Value << YAML::DoubleQuoted << yaml;
+        record << YAML::EndMap;
+        journal << record.c_str() << '\n' << std::flush;
+        if (!journal) {
+            LOG_ERROR("InjectionProject: could not append to journal " + journalName);
+            ok = false;
+            return;
+        }
+        LOG_INFO("InjectionProject: bin " + std::to_string(jobs[j].bin_index) + " done (" + std::to_string(++nFinished) + " of " +
+                 std::to_string(jobs.size()) + " jobs)");
+        // The journal is the checkpoint; the summary is refreshed at most every kSummaryInterval and at the end
+        const auto now = std::chrono::steady_clock::now();
+        if (now - lastSummary < kSummaryInterval)
+            return;
+        lastSummary = now;
+        if (!writeSummary(finishedYaml(jobYaml, finished)))
+            ok = false;
+    };
+    auto binOf = [&](const Job& job) -> const Bin& {
+        auto it = bins.begin();
+        std::advance(it, job.bin_index);
+        return it->second;
+    };
+    std::vector<size_t> pending; // jobs to run, in job order
+    for (size_t j = 0; j < jobs.size(); ++j) {
+        const Job& job = jobs[j];
         // locate bin
         if (static_cast<size_t>(job.bin_index) >= bins.size()) {
             LOG_ERROR("InjectionProject: bin index out of range: " + std::to_string(job.bin_index));
             continue;
         }
-        auto it = bins.begin();
-        std::advance(it, job.bin_index);
-        const Bin& bin = it->second;
-        Inject injector(tree, table, scale, targetPolarization);
-        std::vector<double> extractedVals;
-        std::vector<double> extractedErrs;
-        for (int i = 0; i < job.n; ++i) {
-            auto res = injector.injectExtractForBin(bin, job.extract_with_true, job.A_opt);
-            extractedVals.push_back(res.first);
-            extractedErrs.push_back(res.second);
+        keys[j] = project + jobKey(job, binOf(job));
+        const std::string& key = keys[j];
+        if (!completed[key].empty()) {
+            LOG_INFO("InjectionProject: bin " + std::to_string(job.bin_index) + " already in the journal, skipping");
+            jobYaml[j] = completed[key].front();
+            finished[j] = 1;
+            completed[key].pop_front();
+            continue;
         }
-        // compute simple summary: mean and stddev of extractedVals
-        double mean = 0.0;
-        for (double v : extractedVals) mean += v;
-        mean /= std::max(1, static_cast<int>(extractedVals.size()));
-        double var = 0.0;
-        for (double v : extractedVals) var += (v - mean) * (v - mean);
-        double stddev = extractedVals.size() > 1 ? std::sqrt(var / (extractedVals.size() - 1)) : 0.0;
-        
-        // Emit YAML for this job
-        out << YAML::BeginMap;
-        out << YAML::Key << "bin_index" << YAML::Value << job.bin_index;
-        out << YAML::Key << "events" << YAML::Value << bin.getEvents();
-        out << YAML::Key << "expected_events" << YAML::Value << bin.getExpectedEvents();
-        out << YAML::Key << "X_min" << YAML::Value << bin.getMin("X");
-        out << YAML::Key << "X_max" << YAML::Value << bin.getMax("X");
-        out << YAML::Key << "Q_min" << YAML::Value << bin.getMin("Q");
-        out << YAML::Key << "Q_max" << YAML::Value << bin.getMax("Q");
-        out << YAML::Key << "Z_min" << YAML::Value << bin.getMin("Z");
-        out << YAML::Key << "Z_max" << YAML::Value << bin.getMax("Z");
-        out << YAML::Key << "PhPerp_min" << YAML::Value << bin.getMin("PhPerp");
-        out << YAML::Key << "PhPerp_max" << YAML::Value << bin.getMax("PhPerp");
-        out << YAML::Key << "used_reconstructed_kinematics" << YAML::Value << (!job.extract_with_true);
-        out << YAML::Key << "n_injections" << YAML::Value << job.n;
-        out << YAML::Key << "injected" << YAML::Value << (job.A_opt.has_value() ? job.A_opt.value() : 0.0);
-        out << YAML::Key << "all_extracted" << YAML::Value << YAML::Flow << extractedVals;
-        out << YAML::Key << "all_errors" << YAML::Value << YAML::Flow << extractedErrs;
-        out << YAML::Key << "mean_extracted" << YAML::Value << mean;
-        out << YAML::Key << "stddev_extracted" << YAML::Value << stddev;
-        out << YAML::EndMap;
+        pending.push_back(j);
+    }
 
-        ++jobIdx;
+    if (nThreads == 1) {
+        for (size_t j : pending) {
+            finish(j, runJob(jobs[j], binOf(jobs[j])));
+            if (!ok)
+                return false;
+        }
+    } else {
+        // One task per job prepares its bin, then spawns one task per injection on the preparing worker; idle
+        // workers steal them. The prepared events are shared by the injection tasks and freed with the last one.
+        TaskScheduler scheduler(nThreads);
+        // Every worker reads through its own reader when the input can be reopened, so bin preparations overlap;
+        // otherwise they take turns on the shared source
+        std::mutex readMutex;
+        struct Worker {
+            std::unique_ptr<EventSource> reader;
+            std::unique_ptr<Inject> injector; // kept for the whole run, rebound to the job of each task
+            long job = -1;
+        };
+        std::vector<Worker> workers(nThreads);
+        auto workerFor = [&](size_t j, const JobRun& run) -> Worker& {
+            Worker& w = workers[TaskScheduler::workerIndex()];
+            if (!w.injector) {
+                w.reader = source->reopen();
+                w.injector = makeInjector(w.reader ? w.reader.get() : source);
+                w.injector->setVerbose(false);
+            }
+            if (w.job != static_cast<long>(j)) {
+                bindInjector(*w.injector, run);
+                w.job = static_cast<long>(j);
+            }
+            return w;
+        };
+        LOG_INFO("InjectionProject: running " + std::to_string(pending.size()) + " jobs on " + std::to_string(nThreads) +
+                 " workers");
+        for (size_t j : pending) {
+            scheduler.spawn([&, j]() {
+                if (!ok)
+                    return;
+                auto run = std::make_shared<JobRun>();
+                planJob(*run, jobs[j], binOf(jobs[j]));
+                Worker& w = workerFor(j, *run);
+                if (w.reader) {
+                    prepareJob(*run, *w.injector);
+                } else {
+                    std::lock_guard<std::mutex> lock(readMutex);
+                    prepareJob(*run, *w.injector);
+                }
+                if (!run->splitsInjections() || run->nMax <= 1) {
+                    runInjections(*run, *w.injector);
+                    finish(j, emitJob(*run));
+                    return;
+                }
+                for (auto& toys : run->results)
+                    toys.resize(run->nMax);
+                run->nDone = run->nMax;
+                auto remaining = std::make_shared<std::atomic<int>>(run->nMax);
+                for (int i = 0; i < run->nMax; ++i) {
+                    scheduler.spawn([&, j, run, remaining, i]() {
+                        runInjection(*run, *workerFor(j, *run).injector, i);
+                        if (--*remaining == 0)
+                            finish(j, emitJob(*run));
+                    });
+                }
+            });
+        }
+        scheduler.run();
+        if (!ok)
+            return false;
     }
+    if (autCache && autCache->isDirty() && !autCacheFile.empty())
+        autCache->save(autCacheFile, source->getEntries());
+
+    if (!writeSummary(finishedYaml(jobYaml, finished)))
+        return false;
+    LOG_INFO("InjectionProject: wrote summary to " + outPrefix + ".yaml");
+    return true;
+}
+
+bool InjectionProject::writeSummary(const std::vector<std::string>& jobYaml) const {
+    YAML::Emitter out;
+    out << YAML::BeginMap;
+    out << YAML::Key << "jobs" << YAML::Value << YAML::BeginSeq;
+    for (const auto& text : jobYaml)
+        out << YAML::Load(text);
     out << YAML::EndSeq;
     out << YAML::EndMap;
 
-    // Write to file
-    std::string yamlName = outPrefix + ".yaml";
-    std::ofstream yamlOut(yamlName);
+    // Written next to the summary and renamed over it, so the file is always complete
+    const std::string yamlName = outPrefix + ".yaml";
+    const std::string tmpName = yamlName + ".tmp";
+    std::ofstream yamlOut(tmpName);
     if (!yamlOut.is_open()) {
-        LOG_ERROR("InjectionProject: could not write YAML " + yamlName);
+        LOG_ERROR("InjectionProject: could not write YAML " + tmpName);
         return false;
     }
     yamlOut << out.c_str();
     yamlOut.close();
-    LOG_INFO("InjectionProject: wrote summary to " + yamlName);
+    std::error_code ec;
+    std::filesystem::rename(tmpName, yamlName, ec);
+    if (ec || !yamlOut) {
+        LOG_ERROR("InjectionProject: could not write YAML " + yamlName);
+        return false;
+    }
     return true;
 }
+
+std::string InjectionProject::projectKey() const {
+    // The input (specification, tree and size), the table contents, the grid and the project settings
+    std::ostringstream key;
+    key << std::setprecision(17) << "input=" << filename << ";tree=" << source->getName() << ";entries=" << source->getEntries()
+        << ";table=" << (table ? table->contentHash() : 0ULL) << ";grid=";
+    for (const auto& name : grid->getMainBinNames())
+        key << name << ",";
+    key << ";seed=" << seed << ";pol=" << targetPolarization << ";scale=" << scale << ";range=" << eventRange.tag() << ";";
+    return key.str();
+}
+
+std::string InjectionProject::jobKey(const Job& job, const Bin& bin) const {
+    // Everything that changes the result of a job; a journal record is only reused for an identical job
+    std::ostringstream key;
+    key << std::setprecision(17) << "bin=" << job.bin_index << ";bounds=";
+    for (const char* var : {"X", "Q", "Z", "PhPerp"})
+        key << bin.getMin(var) << ":" << bin.getMax(var) << ",";
+    key << ";n=" << job.n << ";true=" << job.extract_with_true << ";both=" << job.extract_both << ";A=";
+    if (job.A_opt.has_value())
+        key << job.A_opt.value();
+    else
+        key << "table";
+    key << ";crn=" << job.common_random_numbers << ";precision=" << job.target_precision << ";min=" << job.min_injections
+        << ";max=" << job.max_injections << ";asimov=" << job.asimov << ";binned=" << job.binned
+        << ";bootstrap=" << job.bootstrap << ";aggregate=" << job.aggregate << ";A_scan=";
+    for (double a : job.A_scan)
+        key << a << ",";
+    key << ";pol_scan=";
+    for (double p : job.polarization_scan)
+        key << p << ",";
+    key << ";modulations=";
+    for (const auto& m : job.modulations)
+        key << m << ",";
+    key << ";A_modulations=";
+    for (double a : job.A_modulations)
+        key << a << ",";
+    return key.str();
+}
+
+std::string InjectionProject::runJob(const Job& job, const Bin& bin) {
+    JobRun run;
+    planJob(run, job, bin);
+    const std::unique_ptr<Inject> injector = makeInjector(source);
+    bindInjector(*injector, run);
+    prepareJob(run, *injector);
+    runInjections(run, *injector);
+    return emitJob(run);
+}
+
+void InjectionProject::planJob(JobRun& run, const Job& job, const Bin& bin) const {
+    run.job = &job;
+    run.bin = &bin;
+    for (const auto& name : job.modulations) {
+        if (auto m = Modulation::parse(name))
+            run.modulations.push_back(*m);
+        else
+            LOG_WARN("InjectionProject: unknown modulation '" + name + "' ignored");
+    }
+    // Injected configurations: the scanned amplitudes x polarizations, or the job's single one
+    std::vector<std::optional<double>> amplitudes(job.A_scan.begin(), job.A_scan.end());
+    if (amplitudes.empty())
+        amplitudes.push_back(job.A_opt);
+    std::vector<double> polarizations = job.polarization_scan;
+    if (polarizations.empty())
+        polarizations.push_back(targetPolarization);
+    for (const auto& A : amplitudes)
+        for (double pol : polarizations)
+            run.points.push_back(Inject::Point{A, pol, {}});
+    // Injected amplitude of every modulation at each point
+    for (auto& point : run.points) {
+        for (size_t m = 0; m < run.modulations.size(); ++m) {
+            if (m < job.A_modulations.size())
+                point.modulationA.push_back(job.A_modulations[m]);
+            else if (run.modulations[m].kind == Modulation::Kind::Collins)
+                point.modulationA.push_back(point.A);
+            else
+                point.modulationA.push_back(0.0);
+        }
+    }
+    run.isScan = !job.A_scan.empty() || !job.polarization_scan.empty();
+    for (const auto& p : run.points)
+        run.withTable |= p.usesTable();
+    run.fitsReco = job.extract_both || !job.extract_with_true;
+    run.fitsTrue = job.extract_both || job.extract_with_true;
+
+    // Injections run point by point in lockstep. In adaptive mode they stop once both standard
+    // errors are below the target (after min_injections, at most max_injections).
+    // An Asimov job replaces the toys by a single expected-yield fit per point
+    // A bootstrap job fits all n replicas of one injection at once
+    run.adaptive = job.target_precision > 0.0 && !job.asimov && !job.bootstrap;
+    run.nMax = job.asimov || job.bootstrap ? 1 : run.adaptive && job.max_injections > 0 ? job.max_injections : job.n;
+    run.nMin = run.adaptive ? std::min(std::max(2, job.min_injections), run.nMax) : run.nMax;
+    run.results.assign(run.points.size(), {});
+}
+
+std::unique_ptr<Inject> InjectionProject::makeInjector(EventSource* reader) const {
+    auto injector = std::make_unique<Inject>(reader, table, scale, targetPolarization);
+    injector->setEventRange(eventRange);
+    injector->setAUTCache(autCache.get());
+    return injector;
+}
+
+void InjectionProject::bindInjector(Inject& injector, const JobRun& run) const {
+    injector.setRandomStream(seed, static_cast<uint32_t>(run.job->bin_index));
+    injector.setBinnedFit(run.job->binned);
+    injector.setAggregation(run.job->aggregate);
+    injector.setModulations(run.modulations);
+    injector.setSelection(nullptr);
+}
+
+void InjectionProject::prepareJob(JobRun& run, Inject& injector) const {
+    const Job& job = *run.job;
+    // The index only serves bins its rows tile; otherwise the bin is scanned so the selection is the same either way
+    if (binIndex && !binIndex->covers(*run.bin)) {
+        LOG_WARN("InjectionProject: the table rows inside bin " + std::to_string(job.bin_index) +
+                 " do not cover its bounds; scanning the input instead of using the bin index");
+    } else if (binIndex) {
+        run.selection = binIndex->select(*run.bin, job.extract_with_true);
+        if (job.extract_both)
+            run.selection |= binIndex->select(*run.bin, !job.extract_with_true);
+        injector.setSelection(&run.selection);
+        LOG_INFO("InjectionProject: bin index selects " + std::to_string(run.selection.cardinality()) + " entries for bin " +
+                 std::to_string(job.bin_index));
+    }
+    // The events of the bin are read once; each point and injection only redraws the spins and refits
+    run.prep = injector.prepare(*run.bin, run.fitsReco, run.fitsTrue, run.withTable);
+}
+
+void InjectionProject::runInjection(JobRun& run, Inject& injector, int i) const {
+    const Job& job = *run.job;
+    for (size_t p = 0; p < run.points.size(); ++p)
+        run.results[p][i] = injector.injectExtract(run.prep, run.points[p], i, job.common_random_numbers ? 0u : static_cast<uint32_t>(p));
+}
+
+void InjectionProject::runInjections(JobRun& run, Inject& injector) const {
+    const Job& job = *run.job;
+    // Worst standard errors of mean_extracted and stddev_extracted over every point and fitted dataset
+    auto standardErrors = [&](const std::vector<std::vector<Inject::DualResult>>& res) {
+        double seMean = 0.0, seStddev = 0.0;
+        for (const auto& toys : res) {
+            for (bool useTrue : {false, true}) {
+                if (useTrue ? !run.fitsTrue : !run.fitsReco)
+                    continue;
+                std::vector<double> vals;
+                for (const auto& r : toys)
+                    vals.push_back((useTrue ? r.truth : r.reco).first);
+                const double stddev = meanStddev(vals).second;
+                const double n = static_cast<double>(vals.size());
+                seMean = std::max(seMean, n > 0 ? stddev / std::sqrt(n) : 0.0);
+                seStddev = std::max(seStddev, n > 1 ? stddev / std::sqrt(2 * (n - 1)) : 0.0);
+            }
+        }
+        return std::make_pair(seMean, seStddev);
+    };
+
+    auto& results = run.results;
+    for (int i = 0; i < run.nMax; ++i) {
+        for (size_t p = 0; p < run.points.size(); ++p) {
+            if (job.bootstrap)
+                results[p] = injector.bootstrap(run.prep, run.points[p], job.n, job.common_random_numbers ? 0u : static_cast<uint32_t>(p));
+            else if (job.asimov)
+                results[p].push_back(injector.injectExtractAsimov(run.prep, run.points[p]));
+            else
+                results[p].push_back(injector.injectExtract(run.prep, run.points[p], i, job.common_random_numbers ? 0u : static_cast<uint32_t>(p)));
+        }
+        run.nDone = job.bootstrap ? job.n : i + 1;
+        if (!run.adaptive || run.nDone < run.nMin)
+            continue;
+        run.se = standardErrors(results);
+        if (run.se.first < job.target_precision && run.se.second < job.target_precision) {
+            run.converged = true;
+            break;
+        }
+    }
+    if (run.adaptive)
+        LOG_INFO("InjectionProject: bin " + std::to_string(job.bin_index) + (run.converged ? " converged" : " did not converge") +
+                 " after " + std::to_string(run.nDone) + " injections (se(mean) = " + std::to_string(run.se.first) +
+                 ", se(stddev) = " + std::to_string(run.se.second) + ")");
+}
+
+std::string InjectionProject::emitJob(const JobRun& run) const {
+    const Job& job = *run.job;
+    const Bin& bin = *run.bin;
+    const auto& modulations = run.modulations;
+    const auto& points = run.points;
+    const auto& results = run.results;
+    // Events of the fitted dataset, from the first toy (the Bin is shared by concurrent jobs and is not updated)
+    int events = 0, expectedEvents = 0;
+    if (!results.empty() && !results[0].empty()) {
+        const Inject::DualResult& r = results[0][0];
+        events = job.extract_with_true ? r.trueEvents : r.recoEvents;
+        expectedEvents = static_cast<int>(std::round(job.extract_with_true ? r.trueExpectedEvents : r.recoExpectedEvents));
+    }
+
+    YAML::Emitter out;
+    auto emitResults = [&](const std::vector<double>& vals, const std::vector<double>& errs) {
+        const auto [mean, stddev] = meanStddev(vals);
+        out << YAML::Key << "all_extracted" << YAML::Value << YAML::Flow << vals;
+        out << YAML::Key << "all_errors" << YAML::Value << YAML::Flow << errs;
+        out << YAML::Key << "mean_extracted" << YAML::Value << mean;
+        out << YAML::Key << "stddev_extracted" << YAML::Value << stddev;
+    };
+    // Injection-by-injection difference to the reference point. With common random numbers the toys
+    // are paired, so the error of the mean difference is far below the single-point spread.
+    auto emitPairedDifference = [&](const std::vector<double>& vals, const std::vector<double>& refVals) {
+        std::vector<double> diffs;
+        for (size_t i = 0; i < vals.size() && i < refVals.size(); ++i)
+            diffs.push_back(vals[i] - refVals[i]);
+        const auto [mean, stddev] = meanStddev(diffs);
+        const auto [meanA, sA] = meanStddev(vals);
+        const auto [meanB, sB] = meanStddev(refVals);
+        double cov = 0.0;
+        for (size_t i = 0; i < diffs.size(); ++i)
+            cov += (vals[i] - meanA) * (refVals[i] - meanB);
+        cov /= diffs.size() > 1 ? diffs.size() - 1 : 1;
+        const double corr = (sA > 0 && sB > 0) ? cov / (sA * sB) : 0.0;
+        out << YAML::Key << "paired_difference" << YAML::Value << YAML::BeginMap;
+        out << YAML::Key << "reference_point" << YAML::Value << 0;
+        out << YAML::Key << "mean" << YAML::Value << mean;
+        out << YAML::Key << "stddev" << YAML::Value << stddev;
+        out << YAML::Key << "error_of_mean" << YAML::Value << (diffs.empty() ? 0.0 : stddev / std::sqrt(diffs.size()));
+        out << YAML::Key << "correlation" << YAML::Value << corr;
+        out << YAML::EndMap;
+    };
+    // Every modulation of a multi-modulation job, with the mean correlation matrix of the amplitudes over the toys
+    auto emitModulations = [&](const Inject::Point& point, const std::vector<Inject::DualResult>& toys, bool useTrue) {
+        const size_t K = modulations.size();
+        out << YAML::Key << "modulations" << YAML::Value << YAML::BeginSeq;
+        for (size_t m = 0; m < K; ++m) {
+            std::vector<double> vals, errs;
+            for (const auto& r : toys) {
+                const auto& mods = useTrue ? r.trueModulations : r.recoModulations;
+                if (m < mods.size()) {
+                    vals.push_back(mods[m].first);
+                    errs.push_back(mods[m].second);
+                }
+            }
+            out << YAML::BeginMap;
+            out << YAML::Key << "name" << YAML::Value << modulations[m].name();
+            if (point.modulationA[m].has_value())
+                out << YAML::Key << "injected" << YAML::Value << point.modulationA[m].value();
+            else
+                out << YAML::Key << "injected" << YAML::Value << "table";
+            emitResults(vals, errs);
+            out << YAML::EndMap;
+        }
+        out << YAML::EndSeq;
+        std::vector<std::vector<double>> correlation(K, std::vector<double>(K, 0.0));
+        for (const auto& r : toys) {
+            const auto& c = useTrue ? r.trueModulationCorrelation : r.recoModulationCorrelation;
+            for (size_t i = 0; i < K && c.size() == K * K; ++i)
+                for (size_t j = 0; j < K; ++j)
+                    correlation[i][j] += c[i * K + j] / toys.size();
+        }
+        out << YAML::Key << "modulation_correlation" << YAML::Value << YAML::BeginSeq;
+        for (const auto& row : correlation)
+            out << YAML::Flow << row;
+        out << YAML::EndSeq;
+    };
+    // Results of one injected configuration: flat for a single fit, 'reco' and 'true' maps for both
+    auto emitPoint = [&](const Inject::Point& point, const std::vector<Inject::DualResult>& toys,
+                         const std::vector<Inject::DualResult>* reference) {
+        auto emitDataset = [&](bool useTrue) {
+            // Fits with a NaN error (failed bootstrap replicas) are left out; bootstrap jobs count them
+            auto valid = [useTrue](const Inject::DualResult& r) { return !std::isnan((useTrue ? r.truth : r.reco).second); };
+            std::vector<double> vals, errs, rawErrs;
+            for (const auto& r : toys) {
+                if (!valid(r))
+                    continue;
+                vals.push_back((useTrue ? r.truth : r.reco).first);
+                errs.push_back((useTrue ? r.truth : r.reco).second);
+                rawErrs.push_back(useTrue ? r.trueRawError : r.recoRawError);
+            }
+            emitResults(vals, errs);
+            out << YAML::Key << "all_raw_errors" << YAML::Value << YAML::Flow << rawErrs;
+            if (job.bootstrap)
+                out << YAML::Key << "invalid_replicas" << YAML::Value << toys.size() - vals.size();
+            if (!modulations.empty())
+                emitModulations(point, toys, useTrue);
+            if (job.binned > 0) {
+                // Mean fraction of the per-event Fisher information lost to the analyzing-power cells
+                double loss = 0.0;
+                for (const auto& r : toys)
+                    loss += useTrue ? r.trueBinningInfoLoss : r.recoBinningInfoLoss;
+                out << YAML::Key << "binned_cells" << YAML::Value << job.binned;
+                out << YAML::Key << "binned_information_loss" << YAML::Value << loss / std::max<size_t>(1, toys.size());
+            } else if (job.aggregate > 0.0 && modulations.empty() && !job.bootstrap) {
+                // Mean super-event count and relative error change of the merged fits
+                double superEvents = 0.0, change = 0.0;
+                for (const auto& r : toys) {
+                    superEvents += useTrue ? r.trueSuperEvents : r.recoSuperEvents;
+                    change += useTrue ? r.trueAggregationErrorChange : r.recoAggregationErrorChange;
+                }
+                const double nToys = static_cast<double>(std::max<size_t>(1, toys.size()));
+                out << YAML::Key << "aggregate_tolerance" << YAML::Value << job.aggregate;
+                out << YAML::Key << "super_events" << YAML::Value << superEvents / nToys;
+                out << YAML::Key << "aggregation_error_change" << YAML::Value << change / nToys;
+            }
+            if (reference) {
+                // Pairs whose fits both succeeded
+                std::vector<double> a, b;
+                for (size_t i = 0; i < toys.size() && i < reference->size(); ++i) {
+                    if (valid(toys[i]) && valid((*reference)[i])) {
+                        a.push_back((useTrue ? toys[i].truth : toys[i].reco).first);
+                        b.push_back((useTrue ? (*reference)[i].truth : (*reference)[i].reco).first);
+                    }
+                }
+                emitPairedDifference(a, b);
+            }
+        };
+        if (!job.extract_both) {
+            emitDataset(job.extract_with_true);
+            return;
+        }
+        const Inject::DualResult first = toys.empty() ? Inject::DualResult{} : toys.front();
+        // Paired results of the same toys binned and fitted with reco and with true kinematics
+        out << YAML::Key << "reco" << YAML::Value << YAML::BeginMap;
+        out << YAML::Key << "events" << YAML::Value << first.recoEvents;
+        out << YAML::Key << "expected_events" << YAML::Value << static_cast<int>(std::round(first.recoExpectedEvents));
+        emitDataset(false);
+        out << YAML::EndMap;
+        out << YAML::Key << "true" << YAML::Value << YAML::BeginMap;
+        out << YAML::Key << "events" << YAML::Value << first.trueEvents;
+        out << YAML::Key << "expected_events" << YAML::Value << static_cast<int>(std::round(first.trueExpectedEvents));
+        emitDataset(true);
+        out << YAML::EndMap;
+    };
+
+    // Emit YAML for this job
+    out << YAML::BeginMap;
+    out << YAML::Key << "bin_index" << YAML::Value << job.bin_index;
+    if (!job.extract_both) {
+        out << YAML::Key << "events" << YAML::Value << events;
+        out << YAML::Key << "expected_events" << YAML::Value << expectedEvents;
+    }
+    out << YAML::Key << "X_min" << YAML::Value << bin.getMin("X");
+    out << YAML::Key << "X_max" << YAML::Value << bin.getMax("X");
+    out << YAML::Key << "Q_min" << YAML::Value << bin.getMin("Q");
+    out << YAML::Key << "Q_max" << YAML::Value << bin.getMax("Q");
+    out << YAML::Key << "Z_min" << YAML::Value << bin.getMin("Z");
+    out << YAML::Key << "Z_max" << YAML::Value << bin.getMax("Z");
+    out << YAML::Key << "PhPerp_min" << YAML::Value << bin.getMin("PhPerp");
+    out << YAML::Key << "PhPerp_max" << YAML::Value << bin.getMax("PhPerp");
+    if (!job.extract_both)
+        out << YAML::Key << "used_reconstructed_kinematics" << YAML::Value << (!job.extract_with_true);
+    out << YAML::Key << "n_injections" << YAML::Value << run.nDone;
+    if (job.asimov)
+        out << YAML::Key << "asimov" << YAML::Value << true;
+    if (job.bootstrap)
+        out << YAML::Key << "bootstrap" << YAML::Value << true;
+    if (run.adaptive) {
+        // Achieved precision of the adaptive injection count
+        out << YAML::Key << "adaptive" << YAML::Value << YAML::BeginMap;
+        out << YAML::Key << "target_precision" << YAML::Value << job.target_precision;
+        out << YAML::Key << "min_injections" << YAML::Value << run.nMin;
+        out << YAML::Key << "max_injections" << YAML::Value << run.nMax;
+        out << YAML::Key << "converged" << YAML::Value << run.converged;
+        out << YAML::Key << "se_mean_extracted" << YAML::Value << run.se.first;
+        out << YAML::Key << "se_stddev_extracted" << YAML::Value << run.se.second;
+        out << YAML::EndMap;
+    }
+    out << YAML::Key << "seed" << YAML::Value << seed;
+    if (run.isScan) {
+        // Response curve: one entry per injected amplitude and target polarization
+        out << YAML::Key << "common_random_numbers" << YAML::Value << job.common_random_numbers;
+        out << YAML::Key << "scan" << YAML::Value << YAML::BeginSeq;
+        for (size_t p = 0; p < points.size(); ++p) {
+            out << YAML::BeginMap;
+            out << YAML::Key << "injected" << YAML::Value << points[p].A.value_or(0.0);
+            out << YAML::Key << "target_polarization" << YAML::Value << points[p].polarization;
+            emitPoint(points[p], results[p], p > 0 ? &results[0] : nullptr);
+            out << YAML::EndMap;
+        }
+        out << YAML::EndSeq;
+    } else {
+        out << YAML::Key << "injected" << YAML::Value << (job.A_opt.has_value() ? job.A_opt.value() : 0.0);
+        emitPoint(points[0], results.empty() ? std::vector<Inject::DualResult>{} : results[0], nullptr);
+    }
+    out << YAML::EndMap;
+    return out.c_str();
+}
+
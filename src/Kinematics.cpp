@@ -0,0 +1,267 @@
+#include "Kinematics.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+// GCC 12 flags the _mm512_undefined_pd() placeholders inside the AVX-512 intrinsics
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#include <immintrin.h>
+#define KINEMATICS_X86 1
+#endif
+
+namespace {
+constexpr double kProtonMass = 0.938272;
+
+// Cephes sin/cos on [-pi/4, pi/4] (~1e-16 relative error), used by the vector kernels
+constexpr double kFourOverPi = 1.27323954473516268615;
+constexpr double kDP1 = 7.85398125648498535156E-1; // pi/4 split in three parts for the reduction
+constexpr double kDP2 = 3.77489470793079817668E-8;
+constexpr double kDP3 = 2.69515142907905952645E-15;
+constexpr double kSinCof[6] = {1.58962301576546568060E-10, -2.50507477628578072866E-8, 2.75573136213857245213E-6,
+                               -1.98412698295895385996E-4, 8.33333333332211858878E-3, -1.66666666666666307295E-1};
+constexpr double kCosCof[6] = {-1.13585365213876817300E-11, 2.08757008419747316778E-9, -2.75573141792967388112E-7,
+                               2.48015872888517045348E-5, -1.38888888888730564116E-3, 4.16666666666665929218E-2};
+} // namespace
+
+KinematicsBatch::Isa KinematicsBatch::bestIsa() {
+#if KINEMATICS_X86
+    static const Isa isa = [] {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f"))
+            return Isa::AVX512;
+        if (__builtin_cpu_supports("avx2"))
+            return Isa::AVX2;
+        return Isa::Scalar;
+    }();
+    return isa;
+#else
+    return Isa::Scalar;
+#endif
+}
+
+const char* KinematicsBatch::isaName(Isa isa) {
+    switch (isa) {
+    case Isa::AVX512:
+        return "AVX-512";
+    case Isa::AVX2:
+        return "AVX2";
+    default:
+        return "scalar";
+    }
+}
+
+void KinematicsBatch::clear() {
+    for (auto* v : {&X, &Q2, &Y, &PhiH, &PhiS, &Gamma, &S_T, &Depol, &SinPhi})
+        v->clear();
+}
+
+void KinematicsBatch::reserve(size_t n) {
+    for (auto* v : {&X, &Q2, &Y, &PhiH, &PhiS, &Gamma, &S_T, &Depol, &SinPhi})
+        v->reserve(n);
+}
+
+void KinematicsBatch::compute(Isa isa) {
+    const size_t n = size();
+    Gamma.resize(n);
+    S_T.resize(n);
+    Depol.resize(n);
+    SinPhi.resize(n);
+    size_t done = 0;
+    if (isa == Isa::AVX512 && bestIsa() == Isa::AVX512)
+        done = computeAVX512(n);
+    else if (isa != Isa::Scalar && bestIsa() != Isa::Scalar)
+        done = computeAVX2(n);
+    computeScalar(done, n);
+}
+
+// Scalar reference (same expressions and evaluation order as the original per-event code)
+void KinematicsBatch::computeScalar(size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+        const double y = Y[i];
+        const double gamma = Q2[i] > 0 ? 2.0 * X[i] * kProtonMass / std::sqrt(Q2[i]) : 0.0;
+        double inner = (1.0 - y - 0.25 * y * y * gamma * gamma) / (1.0 + gamma * gamma);
+        if (inner < 0.0)
+            inner = 0.0;
+        double sinTheta = gamma * std::sqrt(inner);
+        if (sinTheta > 1.0)
+            sinTheta = 1.0;
+        const double cosTheta = std::sqrt(std::max(0.0, 1.0 - sinTheta * sinTheta));
+        const double sinPhiS = std::sin(PhiS[i]);
+        const double denom = std::sqrt(std::max(1e-12, 1.0 - sinTheta * sinTheta * sinPhiS * sinPhiS));
+        double st = cosTheta / denom;
+        if (!std::isfinite(st))
+            st = 0.0;
+        Gamma[i] = gamma;
+        S_T[i] = st;
+        Depol[i] = (1 - y) / (1 - y + 0.5 * y * y);
+        SinPhi[i] = std::sin(PhiH[i] + PhiS[i]);
+    }
+}
+
+#if KINEMATICS_X86
+
+namespace {
+
+__attribute__((target("avx2"))) inline __m256d polevl256(__m256d x, const double* c) {
+    __m256d r = _mm256_set1_pd(c[0]);
+    for (int k = 1; k < 6; ++k)
+        r = _mm256_add_pd(_mm256_mul_pd(r, x), _mm256_set1_pd(c[k]));
+    return r;
+}
+
+__attribute__((target("avx2"))) inline __m256d sin256(__m256d x) {
+    const __m256d signBit = _mm256_set1_pd(-0.0);
+    __m256d sign = _mm256_and_pd(x, signBit);
+    x = _mm256_andnot_pd(signBit, x);
+    // Octant (made even), then folded to [0, 4)
+    __m256d y = _mm256_floor_pd(_mm256_mul_pd(x, _mm256_set1_pd(kFourOverPi)));
+    y = _mm256_add_pd(y, _mm256_sub_pd(y, _mm256_mul_pd(_mm256_set1_pd(2.0), _mm256_floor_pd(_mm256_mul_pd(y, _mm256_set1_pd(0.5))))));
+    __m256d j = _mm256_sub_pd(y, _mm256_mul_pd(_mm256_set1_pd(8.0), _mm256_floor_pd(_mm256_mul_pd(y, _mm256_set1_pd(0.125)))));
+    const __m256d flip = _mm256_cmp_pd(j, _mm256_set1_pd(3.0), _CMP_GT_OQ);
+    sign = _mm256_xor_pd(sign, _mm256_and_pd(flip, signBit));
+    j = _mm256_sub_pd(j, _mm256_and_pd(flip, _mm256_set1_pd(4.0)));
+    const __m256d useCos = _mm256_cmp_pd(j, _mm256_set1_pd(2.0), _CMP_EQ_OQ);
+
+    __m256d z = _mm256_sub_pd(x, _mm256_mul_pd(y, _mm256_set1_pd(kDP1)));
+    z = _mm256_sub_pd(z, _mm256_mul_pd(y, _mm256_set1_pd(kDP2)));
+    z = _mm256_sub_pd(z, _mm256_mul_pd(y, _mm256_set1_pd(kDP3)));
+    const __m256d zz = _mm256_mul_pd(z, z);
+    const __m256d c = _mm256_add_pd(_mm256_sub_pd(_mm256_set1_pd(1.0), _mm256_mul_pd(zz, _mm256_set1_pd(0.5))),
+                                    _mm256_mul_pd(_mm256_mul_pd(zz, zz), polevl256(zz, kCosCof)));
+    const __m256d s = _mm256_add_pd(z, _mm256_mul_pd(_mm256_mul_pd(z, zz), polevl256(zz, kSinCof)));
+    return _mm256_xor_pd(_mm256_blendv_pd(s, c, useCos), sign);
+}
+
+__attribute__((target("avx512f"))) inline __m512d polevl512(__m512d x, const double* c) {
+    __m512d r = _mm512_set1_pd(c[0]);
+    for (int k = 1; k < 6; ++k)
+        r = _mm512_add_pd(_mm512_mul_pd(r, x), _mm512_set1_pd(c[k]));
+    return r;
+}
+
+__attribute__((target("avx512f"))) inline __m512d floor512(__m512d x) {
+    return _mm512_roundscale_pd(x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+}
+
+__attribute__((target("avx512f"))) inline __m512d sin512(__m512d x) {
+    const __mmask8 negative = _mm512_cmp_pd_mask(x, _mm512_setzero_pd(), _CMP_LT_OQ);
+    x = _mm512_abs_pd(x);
+    __m512d y = floor512(_mm512_mul_pd(x, _mm512_set1_pd(kFourOverPi)));
+    y = _mm512_add_pd(y, _mm512_sub_pd(y, _mm512_mul_pd(_mm512_set1_pd(2.0), floor512(_mm512_mul_pd(y, _mm512_set1_pd(0.5))))));
+    __m512d j = _mm512_sub_pd(y, _mm512_mul_pd(_mm512_set1_pd(8.0), floor512(_mm512_mul_pd(y, _mm512_set1_pd(0.125)))));
+    const __mmask8 flip = _mm512_cmp_pd_mask(j, _mm512_set1_pd(3.0), _CMP_GT_OQ);
+    j = _mm512_mask_sub_pd(j, flip, j, _mm512_set1_pd(4.0));
+    const __mmask8 useCos = _mm512_cmp_pd_mask(j, _mm512_set1_pd(2.0), _CMP_EQ_OQ);
+
+    __m512d z = _mm512_sub_pd(x, _mm512_mul_pd(y, _mm512_set1_pd(kDP1)));
+    z = _mm512_sub_pd(z, _mm512_mul_pd(y, _mm512_set1_pd(kDP2)));
+    z = _mm512_sub_pd(z, _mm512_mul_pd(y, _mm512_set1_pd(kDP3)));
+    const __m512d zz = _mm512_mul_pd(z, z);
+    const __m512d c = _mm512_add_pd(_mm512_sub_pd(_mm512_set1_pd(1.0), _mm512_mul_pd(zz, _mm512_set1_pd(0.5))),
+                                    _mm512_mul_pd(_mm512_mul_pd(zz, zz), polevl512(zz, kCosCof)));
+    const __m512d s = _mm512_add_pd(z, _mm512_mul_pd(_mm512_mul_pd(z, zz), polevl512(zz, kSinCof)));
+    const __m512d r = _mm512_mask_blend_pd(useCos, s, c);
+    return _mm512_mask_sub_pd(r, negative ^ flip, _mm512_setzero_pd(), r);
+}
+
+} // namespace
+
+// Comparisons are ordered and blends replace only where the scalar code would, so NaN/inf inputs
+// propagate exactly as in computeScalar
+__attribute__((target("avx2"))) size_t KinematicsBatch::computeAVX2(size_t n) {
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d one = _mm256_set1_pd(1.0);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m256d x = _mm256_loadu_pd(&X[i]);
+        const __m256d q2 = _mm256_loadu_pd(&Q2[i]);
+        const __m256d y = _mm256_loadu_pd(&Y[i]);
+        const __m256d phiS = _mm256_loadu_pd(&PhiS[i]);
+        const __m256d phiH = _mm256_loadu_pd(&PhiH[i]);
+
+        const __m256d q2Positive = _mm256_cmp_pd(q2, zero, _CMP_GT_OQ);
+        __m256d gamma = _mm256_div_pd(_mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(2.0), x), _mm256_set1_pd(kProtonMass)),
+                                      _mm256_sqrt_pd(q2));
+        gamma = _mm256_and_pd(gamma, q2Positive);
+
+        const __m256d gg = _mm256_mul_pd(gamma, gamma);
+        __m256d num = _mm256_sub_pd(_mm256_sub_pd(one, y),
+                                    _mm256_mul_pd(_mm256_mul_pd(_mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(0.25), y), y), gamma), gamma));
+        __m256d inner = _mm256_div_pd(num, _mm256_add_pd(one, gg));
+        inner = _mm256_blendv_pd(inner, zero, _mm256_cmp_pd(inner, zero, _CMP_LT_OQ));
+        __m256d sinTheta = _mm256_mul_pd(gamma, _mm256_sqrt_pd(inner));
+        sinTheta = _mm256_blendv_pd(sinTheta, one, _mm256_cmp_pd(sinTheta, one, _CMP_GT_OQ));
+        const __m256d s2 = _mm256_mul_pd(sinTheta, sinTheta);
+        // std::max(c, v) keeps c when v is NaN, as does max_pd(v, c)
+        const __m256d cosTheta = _mm256_sqrt_pd(_mm256_max_pd(_mm256_sub_pd(one, s2), zero));
+        const __m256d sinPhiS = sin256(phiS);
+        const __m256d denom = _mm256_sqrt_pd(
+            _mm256_max_pd(_mm256_sub_pd(one, _mm256_mul_pd(_mm256_mul_pd(s2, sinPhiS), sinPhiS)), _mm256_set1_pd(1e-12)));
+        __m256d st = _mm256_div_pd(cosTheta, denom);
+        st = _mm256_and_pd(st, _mm256_cmp_pd(_mm256_sub_pd(st, st), zero, _CMP_EQ_OQ)); // non-finite -> 0
+
+        const __m256d oneMinusY = _mm256_sub_pd(one, y);
+        const __m256d depol =
+            _mm256_div_pd(oneMinusY, _mm256_add_pd(oneMinusY, _mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(0.5), y), y)));
+
+        _mm256_storeu_pd(&Gamma[i], gamma);
+        _mm256_storeu_pd(&S_T[i], st);
+        _mm256_storeu_pd(&Depol[i], depol);
+        _mm256_storeu_pd(&SinPhi[i], sin256(_mm256_add_pd(phiH, phiS)));
+    }
+    return i;
+}
+
+__attribute__((target("avx512f"))) size_t KinematicsBatch::computeAVX512(size_t n) {
+    const __m512d zero = _mm512_setzero_pd();
+    const __m512d one = _mm512_set1_pd(1.0);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m512d x = _mm512_loadu_pd(&X[i]);
+        const __m512d q2 = _mm512_loadu_pd(&Q2[i]);
+        const __m512d y = _mm512_loadu_pd(&Y[i]);
+        const __m512d phiS = _mm512_loadu_pd(&PhiS[i]);
+        const __m512d phiH = _mm512_loadu_pd(&PhiH[i]);
+
+        const __mmask8 q2Positive = _mm512_cmp_pd_mask(q2, zero, _CMP_GT_OQ);
+        const __m512d gamma = _mm512_maskz_div_pd(
+            q2Positive, _mm512_mul_pd(_mm512_mul_pd(_mm512_set1_pd(2.0), x), _mm512_set1_pd(kProtonMass)), _mm512_sqrt_pd(q2));
+
+        const __m512d gg = _mm512_mul_pd(gamma, gamma);
+        const __m512d num = _mm512_sub_pd(_mm512_sub_pd(one, y),
+                                          _mm512_mul_pd(_mm512_mul_pd(_mm512_mul_pd(_mm512_mul_pd(_mm512_set1_pd(0.25), y), y), gamma), gamma));
+        __m512d inner = _mm512_div_pd(num, _mm512_add_pd(one, gg));
+        inner = _mm512_mask_mov_pd(inner, _mm512_cmp_pd_mask(inner, zero, _CMP_LT_OQ), zero);
+        __m512d sinTheta = _mm512_mul_pd(gamma, _mm512_sqrt_pd(inner));
+        sinTheta = _mm512_mask_mov_pd(sinTheta, _mm512_cmp_pd_mask(sinTheta, one, _CMP_GT_OQ), one);
+        const __m512d s2 = _mm512_mul_pd(sinTheta, sinTheta);
+        const __m512d cosTheta = _mm512_sqrt_pd(_mm512_max_pd(_mm512_sub_pd(one, s2), zero));
+        const __m512d sinPhiS = sin512(phiS);
+        const __m512d denom = _mm512_sqrt_pd(
+            _mm512_max_pd(_mm512_sub_pd(one, _mm512_mul_pd(_mm512_mul_pd(s2, sinPhiS), sinPhiS)), _mm512_set1_pd(1e-12)));
+        __m512d st = _mm512_div_pd(cosTheta, denom);
+        st = _mm512_maskz_mov_pd(_mm512_cmp_pd_mask(_mm512_sub_pd(st, st), zero, _CMP_EQ_OQ), st); // non-finite -> 0
+
+        const __m512d oneMinusY = _mm512_sub_pd(one, y);
+        const __m512d depol =
+            _mm512_div_pd(oneMinusY, _mm512_add_pd(oneMinusY, _mm512_mul_pd(_mm512_mul_pd(_mm512_set1_pd(0.5), y), y)));
+
+        _mm512_storeu_pd(&Gamma[i], gamma);
+        _mm512_storeu_pd(&S_T[i], st);
+        _mm512_storeu_pd(&Depol[i], depol);
+        _mm512_storeu_pd(&SinPhi[i], sin512(_mm512_add_pd(phiH, phiS)));
+    }
+    return i;
+}
+
+#else
+
+size_t KinematicsBatch::computeAVX2(size_t) {
+    return 0;
+}
+
+size_t KinematicsBatch::computeAVX512(size_t) {
+    return 0;
+}
+
+#endif
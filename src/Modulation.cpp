@@ -0,0 +1,123 @@
+#include "Modulation.h"
+#include <algorithm>
+#include <cctype>
+
+std::optional<Modulation> Modulation::parse(const std::string& name) {
+    std::string lower(name);
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return std::tolower(c); });
+    if (lower == "collins")
+        return Modulation{Kind::Collins};
+    if (lower == "sivers")
+        return Modulation{Kind::Sivers};
+    if (lower == "pretzelosity")
+        return Modulation{Kind::Pretzelosity};
+    return std::nullopt;
+}
+
+const char* Modulation::name() const {
+    switch (kind) {
+    case Kind::Sivers:
+        return "sivers";
+    case Kind::Pretzelosity:
+        return "pretzelosity";
+    default:
+        return "collins";
+    }
+}
+
+void ModulationMoments::reset(int k) {
+    K = k;
+    m2.assign(static_cast<size_t>(K) * K, 0.0);
+    m4.assign(static_cast<size_t>(K) * K * K * K, 0.0);
+}
+
+void ModulationMoments::add(const double* b, double w) {
+    size_t idx = 0;
+    for (int i = 0; i < K; ++i) {
+        const double wi = w * b[i];
+        for (int j = 0; j < K; ++j) {
+            const double wij = wi * b[j];
+            m2[i * K + j] += wij;
+            for (int k = 0; k < K; ++k) {
+                const double wijk = wij * b[k];
+                for (int l = 0; l < K; ++l)
+                    m4[idx++] += wijk * b[l];
+            }
+        }
+    }
+}
+
+namespace {
+// Inverse of a small dense matrix by Gauss-Jordan elimination with partial pivoting (a is overwritten)
+bool invert(std::vector<double>& a, int n, std::vector<double>& inv) {
+    inv.assign(static_cast<size_t>(n) * n, 0.0);
+    for (int i = 0; i < n; ++i)
+        inv[i * n + i] = 1.0;
+    double scale = 0.0;
+    for (double x : a)
+        scale = std::max(scale, std::abs(x));
+    for (int c = 0; c < n; ++c) {
+        int pivot = c;
+        for (int r = c + 1; r < n; ++r)
+            if (std::abs(a[r * n + c]) > std::abs(a[pivot * n + c]))
+                pivot = r;
+        if (!(std::abs(a[pivot * n + c]) > 1e-12 * scale))
+            return false;
+        for (int k = 0; k < n; ++k) {
+            std::swap(a[c * n + k], a[pivot * n + k]);
+            std::swap(inv[c * n + k], inv[pivot * n + k]);
+        }
+        const double d = a[c * n + c];
+        for (int k = 0; k < n; ++k) {
+            a[c * n + k] /= d;
+            inv[c * n + k] /= d;
+        }
+        for (int r = 0; r < n; ++r) {
+            if (r == c)
+                continue;
+            const double f = a[r * n + c];
+            for (int k = 0; k < n; ++k) {
+                a[r * n + k] -= f * a[c * n + k];
+                inv[r * n + k] -= f * inv[c * n + k];
+            }
+        }
+    }
+    return true;
+}
+} // namespace
+
+bool solveModulations(const ModulationMoments& moments, const std::vector<double>& v, double polarization, std::vector<double>& A,
+                      std::vector<double>& cov) {
+    const int K = moments.K;
+    A.assign(K, 0.0);
+    cov.assign(static_cast<size_t>(K) * K, 0.0);
+    // Work matrices reused by the next solve of the thread (one per injection)
+    thread_local std::vector<double> work, inv, covV;
+    work = moments.m2;
+    if (K == 0 || polarization <= 0.0 || !invert(work, K, inv))
+        return false;
+    for (int i = 0; i < K; ++i)
+        for (int j = 0; j < K; ++j)
+            A[i] += inv[i * K + j] * v[j] / polarization;
+
+    // Covariance of v at the fitted amplitudes, then propagated through M2^-1
+    covV = moments.m2;
+    const double p2 = polarization * polarization;
+    for (int i = 0; i < K; ++i)
+        for (int j = 0; j < K; ++j) {
+            double q = 0.0;
+            for (int k = 0; k < K; ++k)
+                for (int l = 0; l < K; ++l)
+                    q += moments.m4[((i * K + j) * K + k) * K + l] * A[k] * A[l];
+            covV[i * K + j] -= p2 * q;
+        }
+    for (int i = 0; i < K; ++i)
+        for (int j = 0; j < K; ++j) {
+            double c = 0.0;
+            for (int k = 0; k < K; ++k)
+                for (int l = 0; l < K; ++l)
+                    c += inv[i * K + k] * covV[k * K + l] * inv[l * K + j];
+            cov[i * K + j] = c / p2;
+        }
+    return true;
+}
@@ -1,13 +1,12 @@
 #include "TMD.h"
 #include "Grid.h"
-#include "Hist.h"
 #include "Logger.h"
-#include "Plotter.h"
 #include "TCut.h"
-#include <TEntryList.h>
+#include "TROOT.h"
 #include <filesystem>
 #include <iostream>
 #include <map>
+#include <memory>
 #include "Utility.h"
 
 TMD::TMD(const std::string& filename, const std::string& treename)
@@ -17,72 +16,138 @@ TMD::TMD(const std::string& filename, const std::string& treename)
     , treename(treename)
     , table(nullptr)
     , grid(nullptr) {
-    file = TFile::Open(filename.c_str());
+    inputFiles = util::expandInputFiles(filename);
+    if (inputFiles.empty()) {
+        LOG_ERROR(std::string("No input files match ") + filename);
+        return;
+    }
+    file = TFile::Open(inputFiles.front().c_str());
     if (!file || file->IsZombie()) {
-        LOG_ERROR(std::string("Could not open file ") + filename);
+        LOG_ERROR(std::string("Could not open file ") + inputFiles.front());
         file = nullptr;
         return;
     }
-    tree = dynamic_cast<TTree*>(file->Get(treename.c_str()));
-    if (!tree) {
-        LOG_ERROR(std::string("Could not find tree ") + treename + " in file: " + filename);
+    if (dynamic_cast<TTree*>(file->Get(treename.c_str()))) {
+        source = TreeEventSource::open(inputFiles, treename);
+        if (source)
+            tree = source->getTree();
+    } else {
+        // Not a TTree: try an RNTuple with the same name and field names
+        source = RNTupleEventSource::open(inputFiles, treename);
+        if (source)
+            LOG_INFO(std::string("Reading RNTuple ") + treename + " from file: " + filename);
+    }
+    if (!source) {
+        LOG_ERROR(std::string("Could not find tree or RNTuple ") + treename + " in file: " + filename);
         file->Close();
         file = nullptr;
         tree = nullptr;
         return;
     }
-    // Attempt to read metadata vectors XsTotal (vector<double>) and TotalEvents (vector<int>) from the file
-    if (file->Get("XsTotal") && file->Get("TotalEvents")) {
-        std::vector<double>* xsPtr = nullptr;
-        std::vector<int>* evPtr = nullptr;
-        file->GetObject("XsTotal", xsPtr);
-        file->GetObject("TotalEvents", evPtr);
-        xsTotal = xsPtr->at(0);
-        totalEvents = static_cast<long long>(evPtr->at(0));
-        LOG_INFO("Loaded XsTotal=" + std::to_string(xsTotal) + ", TotalEvents=" + std::to_string(totalEvents));
-    } else {
-        LOG_WARN("TMD: Could not find XsTotal and TotalEvents branches in tree; skipping mc scaling initialization.");
-    }
-    // Require Q2 branch in the tree (we assume input trees provide Q2)
-    if (!tree->GetBranch("Q2")) {
+    loadMetadata();
+    // Require Q2 column in the input (we assume input trees provide Q2)
+    if (!source->hasColumn("Q2")) {
         LOG_ERROR("TMD: Required branch 'Q2' not found in tree.");
     }
-    LOG_INFO(std::string("Successfully loaded TTree: ") + treename + " from file: " + filename);
-    hist = std::make_unique<Hist>(tree);
-    plotter = std::make_unique<Plotter>();
+    LOG_INFO(std::string("Successfully loaded TTree: ") + treename + " from " + std::to_string(inputFiles.size()) + " file(s): " + filename);
 }
 
 TMD::~TMD() {
+    hist.reset();
+    source.reset();
     if (file)
         file->Close();
     // unique_ptr handles table cleanup
 }
 
+void TMD::loadMetadata() {
+    // XsTotal (vector<double>) and TotalEvents (vector<int>) are stored per file. Event counts add up;
+    // the cross-section is averaged weighted by each file's generated events.
+    long long sumEvents = 0;
+    double sumXsEvents = 0.0;
+    for (const auto& path : inputFiles) {
+        std::unique_ptr<TFile> f(path == inputFiles.front() ? nullptr : TFile::Open(path.c_str()));
+        TFile* cur = f ? f.get() : file;
+        std::vector<double>* xsPtr = nullptr;
+        std::vector<int>* evPtr = nullptr;
+        if (cur && !cur->IsZombie()) {
+            cur->GetObject("XsTotal", xsPtr);
+            cur->GetObject("TotalEvents", evPtr);
+        }
+        if (!xsPtr || !evPtr || xsPtr->empty() || evPtr->empty()) {
+            LOG_WARN("TMD: Could not find XsTotal and TotalEvents in " + path + "; skipping mc scaling initialization.");
+            return;
+        }
+        const long long events = static_cast<long long>(evPtr->at(0));
+        if (inputFiles.size() > 1)
+            LOG_INFO("  " + path + ": XsTotal=" + std::to_string(xsPtr->at(0)) + ", TotalEvents=" + std::to_string(events));
+        sumEvents += events;
+        sumXsEvents += xsPtr->at(0) * static_cast<double>(events);
+    }
+    if (sumEvents <= 0) {
+        LOG_WARN("TMD: TotalEvents is zero; skipping mc scaling initialization.");
+        return;
+    }
+    totalEvents = sumEvents;
+    xsTotal = sumXsEvents / static_cast<double>(sumEvents);
+    LOG_INFO("Loaded XsTotal=" + std::to_string(xsTotal) + ", TotalEvents=" + std::to_string(totalEvents));
+}
+
+void TMD::setThreads(int n) {
+    nThreads = std::max(1, n);
+    if (nThreads > 1)
+        ROOT::EnableThreadSafety();
+}
+
 void TMD::setMaxEntries(Long64_t maxEntries) {
-    if (tree && maxEntries > 0) {
-        TEntryList* elist = new TEntryList("elist", "Max Entries");
-        for (Long64_t i = 0; i < std::min(tree->GetEntries(), maxEntries); i++)
-            elist->Enter(i);
-        tree->SetEntryList(elist);
+    if (maxEntries > 0)
+        setEventRange(EventRange::firstN(maxEntries));
+}
+
+void TMD::setEventRange(const EventRange& range) {
+    eventRange = range;
+    if (source && !eventRange.isFull())
+        LOG_INFO("Processing " + std::to_string(static_cast<Long64_t>(eventRange.count(source->getEntries()))) + " of " +
+                 std::to_string(source->getEntries()) + " entries.");
+    // The scale depends on the processed fraction; refresh it if the table was already loaded
+    if (table)
+        updateScale();
+}
+
+const EventRange& TMD::getEventRange() const {
+    return eventRange;
+}
+
+void TMD::updateScale() {
+    // compute scale if we have the necessary mc info
+    if (!(totalEvents > 0 && xsTotal > 0.0))
+        return;
+    scale = util::computeScale(totalEvents, xsTotal, energyConfig, mc_lumi, exp_lumi);
+    // A subsample carries only part of the MC luminosity
+    const double acceptance = source ? eventRange.acceptance(source->getEntries()) : 1.0;
+    if (acceptance > 0.0 && acceptance < 1.0) {
+        scale /= acceptance;
+        LOG_INFO("Event range keeps a fraction " + std::to_string(acceptance) + " of the input; scale adjusted accordingly.");
     }
+    LOG_INFO("Computed scale=" + std::to_string(scale));
 }
 
 bool TMD::isLoaded() const {
-    return file && tree;
+    return file && source;
 }
 
 TTree* TMD::getTree() const {
     return tree;
 }
 
+EventSource* TMD::getSource() const {
+    return source.get();
+}
+
 void TMD::loadTable(){
     this->energyConfig = "default"; // store for cache naming
     table = std::make_unique<Table>();
-    // compute scale if we have the necessary mc info
-    if (totalEvents > 0 && xsTotal > 0.0) {
-        scale = util::computeScale(totalEvents, xsTotal, energyConfig, mc_lumi, exp_lumi);
-        LOG_INFO("Computed scale=" + std::to_string(scale));
-    }
+    updateScale();
 }
 
 void TMD::loadTable(const std::string& tablePath, const std::string& energyConfig) {
@@ -92,11 +157,7 @@ void TMD::loadTable(const std::string& tablePath, const std::string& energyConfi
     }
     this->energyConfig = energyConfig; // store for cache naming
     table = std::make_unique<Table>(tablePath);
-    // compute scale if we have the necessary mc info
-    if (totalEvents > 0 && xsTotal > 0.0) {
-        scale = util::computeScale(totalEvents, xsTotal, energyConfig, mc_lumi, exp_lumi);
-        LOG_INFO("Computed scale=" + std::to_string(scale));
-    }
+    updateScale();
 }
 
 const Table* TMD::getTable() const {
@@ -109,10 +170,38 @@ void TMD::buildGrid(const std::vector<std::string>& _binNames) {
     }
     binNames = _binNames; // save locally
     grid = std::make_unique<Grid>(table->buildGrid(_binNames));
+    binCuts = generateBinCuts(*grid);
     binTCuts = generateBinTCuts(*grid);
     LOG_INFO("Successfully generated " + std::to_string(binTCuts.size()) + " bin TCuts.");
 }
 
+void TMD::buildBinIndex(bool overwrite) {
+    if (!source || !table) {
+        LOG_ERROR("TMD::buildBinIndex requires a loaded tree and table.");
+        return;
+    }
+    std::filesystem::path dir(outDir);
+    if (!std::filesystem::exists(dir)) {
+        std::filesystem::create_directories(dir);
+    }
+    // Compose cache filename: index_<rootstem>__<treename>__<energyConfig>__nrow<N>.root
+    std::string rootStem = util::inputStem(filename);
+    std::string cacheName = "index_" + rootStem + "__" + treename + "__" + energyConfig + "__nrow" +
+                            std::to_string(table->getRows().size()) + eventRange.tag() + ".root";
+    std::filesystem::path cachePath = dir / cacheName;
+
+    binIndex = std::make_unique<BinIndex>();
+    if (!overwrite && std::filesystem::exists(cachePath) && binIndex->load(cachePath.string(), *table, source->getEntries())) {
+        return;
+    }
+    binIndex->build(*source, *table, eventRange, nThreads);
+    binIndex->save(cachePath.string());
+}
+
+const BinIndex* TMD::getBinIndex() const {
+    return binIndex.get();
+}
+
 const std::map<std::string, TCut>& TMD::getBinTCuts() const {
     return binTCuts;
 }
@@ -127,7 +216,16 @@ void TMD::queueInjection(const InjectionProject::Job& job) {
         return;
     }
     if(proj == nullptr) {
-        proj = new InjectionProject(filename, tree, table.get(), scale, grid.get(), targetPolarization, outDir, outFilename);
+        proj = new InjectionProject(filename, source.get(), table.get(), scale, grid.get(), targetPolarization, outDir, outFilename);
+        proj->setBinIndex(binIndex.get());
+        proj->setEventRange(eventRange);
+        proj->setSeed(seed);
+        proj->setResume(resumeInjections);
+        proj->setOverwrite(overwriteInjections);
+        // Per-entry AUT lookups are kept next to the other per-input caches: aut_<rootstem>__<treename>__<energyConfig>.root
+        std::filesystem::create_directories(outDir);
+        proj->setAUTCacheFile((std::filesystem::path(outDir) /
+                               ("aut_" + util::inputStem(filename) + "__" + treename + "__" + energyConfig + ".root")).string());
     }
     proj->addJob(job);
 }
@@ -137,14 +235,47 @@ void TMD::runQueuedInjections() {
         LOG_ERROR("No queued InjectionProject to run.");
         return;
     }
+    proj->setThreads(nThreads);
     bool ok = proj->run();
     if (!ok) {
         LOG_ERROR("InjectionProject failed");
     }
 }
 
+bool TMD::projectErrors(double amplitude, const std::string& toyYaml, int fastToys) {
+    if (!grid) {
+        LOG_ERROR("Grid not built. Cannot project errors.");
+        return false;
+    }
+    ErrorProjection projection(source.get(), grid.get(), scale, targetPolarization);
+    projection.setAmplitude(amplitude);
+    projection.setEventRange(eventRange);
+    projection.setThreads(nThreads);
+    std::filesystem::create_directories(outDir);
+    if (fastToys > 0) {
+        // The densities do not depend on the table, so they are shared by every table version
+        projection.setFastToys(fastToys);
+        projection.setSeed(seed);
+        projection.setInputFiles(inputFiles);
+        projection.setDensityCache(
+            (std::filesystem::path(outDir) / ("density_" + util::inputStem(filename) + "__" + treename + ".root")).string());
+    }
+    projection.run();
+    const std::string name =
+        !outFilename.empty() ? outFilename : "projection_" + util::inputStem(filename) + "_" + source->getName() + ".yaml";
+    return projection.writeYaml((std::filesystem::path(outDir) / name).string(), toyYaml);
+}
+
 std::map<std::string, TCut> TMD::generateBinTCuts(const Grid& grid) const {
     std::map<std::string, TCut> binTCuts;
+    for (const auto& binPair : generateBinCuts(grid)) {
+        binTCuts[binPair.first] = binPair.second.cut;
+    }
+    return binTCuts;
+}
+
+std::map<std::string, BinCut> TMD::generateBinCuts(const Grid& grid) const {
+    std::map<std::string, BinCut> binCuts;
     const auto& bins = grid.getBins();
     for (const auto& binPair : bins) {
         const std::string& key = binPair.first;
@@ -165,66 +296,7 @@ std::map<std::string, TCut> TMD::generateBinTCuts(const Grid& grid) const {
         if (q2max <= q2min) q2max = q2min + 1e-6;
         std::string cutStr = "X >= " + std::to_string(X_min) + " && X < " + std::to_string(X_max) +
                              " && Q2 >= " + std::to_string(q2min) + " && Q2 < " + std::to_string(q2max);
-        binTCuts[key] = TCut(cutStr.c_str());
+        binCuts[key] = BinCut{TCut(cutStr.c_str()), X_min, X_max, q2min, q2max};
     }
-    return binTCuts;
+    return binCuts;
 }
-
-void TMD::fillHistograms(const std::string& var, const std::string& outDir, bool overwrite) {
-    if (!hist)
-        return;
-
-    // Ensure out directory exists
-    std::filesystem::path dir(outDir);
-    if (!std::filesystem::exists(dir)) {
-        std::filesystem::create_directories(dir);
-    }
-
-    // Format binNames as "__X.Q.Z__" etc.
-    std::string binNamesStr = "___";
-    for (size_t i = 0; i < binNames.size(); ++i) {
-        binNamesStr += binNames[i];
-        if (i + 1 < binNames.size())
-            binNamesStr += ".";
-    }
-    binNamesStr += "___";
-
-    // Compose cache filename: hists_<rootstem>__<treename>__<energyConfig>__<binNamesStr><var>__nbins<N>.root
-    std::string rootStem = std::filesystem::path(filename).stem().string();
-    size_t nBins = binTCuts.size();
-    std::string cacheName =
-        "hists_" + rootStem + "__" + treename + "__" + energyConfig + binNamesStr + var + "__nbin" + std::to_string(nBins) + ".root";
-    std::filesystem::path cachePath = dir / cacheName;
-
-    bool histLoaded = false;
-    bool meanLoaded = false;
-    if (!overwrite && std::filesystem::exists(cachePath)) {
-        histLoaded = hist->loadHistCache(cachePath.string(), var);
-        meanLoaded = hist->loadMeanCache(cachePath.string(), var);
-        if (histLoaded && meanLoaded) {
-            LOG_INFO("Using cached histograms and means: " + cachePath.string());
-            return;
-        }
-    }
-
-    // Build histograms and save (apply MC scale)
-    hist->fillHistograms(var, binTCuts, scale);
-    hist->saveHistCache(cachePath.string(), var);
-    hist->saveMeanCache(cachePath.string(), var);
-}
-
-void TMD::plot1DBin(const std::string& var, size_t binIndex, const std::string& outpath) {
-    if (!hist || !plotter)
-        return;
-    plotter->plot1DBin(var, hist.get(), binIndex, outpath);
-}
-
-void TMD::plot2DMap(const std::string& var, const std::string& outpath) {
-    if (binNames.size() != 2) {
-        std::cerr << "plot2DMap requires exactly 2 bin names." << std::endl;
-        return;
-    }
-    if (!hist || !grid || !plotter)
-        return;
-    plotter->plot2DMap(var, hist.get(), grid.get(), outpath);
-}
\ No newline at end of file
@@ -0,0 +1,84 @@
+#include "Hist.h"
+#include "Logger.h"
+#include "Plotter.h"
+#include "TMD.h"
+#include "Utility.h"
+#include <filesystem>
+#include <iostream>
+
+// TMD's histogramming and plotting, built into the plotting library so that the core never references Hist or Plotter
+
+Hist& TMD::getHist() {
+    if (!hist)
+        hist = std::make_shared<Hist>(source.get());
+    hist->setThreads(nThreads);
+    hist->setEventRange(eventRange);
+    return *hist;
+}
+
+Plotter& TMD::getPlotter() {
+    if (!plotter)
+        plotter = std::make_shared<Plotter>();
+    return *plotter;
+}
+
+void TMD::fillHistograms(const std::string& var, const std::string& outDir, bool overwrite) {
+    if (!source)
+        return;
+    Hist& hist = getHist();
+
+    // Ensure out directory exists
+    std::filesystem::path dir(outDir);
+    if (!std::filesystem::exists(dir)) {
+        std::filesystem::create_directories(dir);
+    }
+
+    // Format binNames as "__X.Q.Z__" etc.
+    std::string binNamesStr = "___";
+    for (size_t i = 0; i < binNames.size(); ++i) {
+        binNamesStr += binNames[i];
+        if (i + 1 < binNames.size())
+            binNamesStr += ".";
+    }
+    binNamesStr += "___";
+
+    // Compose cache filename: hists_<rootstem>__<treename>__<energyConfig>__<binNamesStr><var>__nbins<N>.root
+    std::string rootStem = util::inputStem(filename);
+    size_t nBins = binTCuts.size();
+    std::string cacheName = "hists_" + rootStem + "__" + treename + "__" + energyConfig + binNamesStr + var + "__nbin" +
+                            std::to_string(nBins) + eventRange.tag() + ".root";
+    std::filesystem::path cachePath = dir / cacheName;
+
+    bool histLoaded = false;
+    bool meanLoaded = false;
+    if (!overwrite && std::filesystem::exists(cachePath)) {
+        histLoaded = hist.loadHistCache(cachePath.string(), var);
+        meanLoaded = hist.loadMeanCache(cachePath.string(), var);
+        if (histLoaded && meanLoaded) {
+            LOG_INFO("Using cached histograms and means: " + cachePath.string());
+            return;
+        }
+    }
+
+    // Build histograms and save (apply MC scale). The histogram bins only cut on X and Q2, so they are not served by
+    // the bin index, whose rows also restrict Z and PhPerp.
+    hist.fillHistograms(var, binCuts, scale);
+    hist.saveHistCache(cachePath.string(), var);
+    hist.saveMeanCache(cachePath.string(), var);
+}
+
+void TMD::plot1DBin(const std::string& var, size_t binIndex, const std::string& outpath) {
+    if (!source)
+        return;
+    getPlotter().plot1DBin(var, &getHist(), binIndex, outpath);
+}
+
+void TMD::plot2DMap(const std::string& var, const std::string& outpath) {
+    if (binNames.size() != 2) {
+        std::cerr << "plot2DMap requires exactly 2 bin names." << std::endl;
+        return;
+    }
+    if (!source || !grid)
+        return;
+    getPlotter().plot2DMap(var, &getHist(), grid.get(), outpath);
+}
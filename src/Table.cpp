@@ -158,4 +158,23 @@ double Table::lookupAUT(double X, double Q, double Z, double PhPerp) const {
     }
 
     return bestAUT;
-}
\ No newline at end of file
+}
+
+unsigned long long Table::contentHash() const {
+    // FNV-1a over the raw bytes of every row field
+    unsigned long long h = 1469598103934665603ULL;
+    auto mix = [&h](const void* data, size_t n) {
+        const auto* p = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < n; ++i) {
+            h ^= p[i];
+            h *= 1099511628211ULL;
+        }
+    };
+    for (const auto& row : rows) {
+        mix(&row.itar, sizeof(row.itar));
+        mix(&row.ihad, sizeof(row.ihad));
+        for (double v : {row.X_min, row.X_max, row.Q_min, row.Q_max, row.Z_min, row.Z_max, row.PhPerp_min, row.PhPerp_max, row.AUT})
+            mix(&v, sizeof(v));
+    }
+    return h;
+}
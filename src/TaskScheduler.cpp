@@ -0,0 +1,103 @@
+#include "TaskScheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace {
+// Worker running on this thread, and its scheduler
+thread_local int currentWorker = -1;
+thread_local const TaskScheduler* currentScheduler = nullptr;
+} // namespace
+
+TaskScheduler::TaskScheduler(int n)
+    : nThreads(std::max(1, n)) {
+    for (int w = 0; w < nThreads; ++w)
+        workers.push_back(std::make_unique<Worker>());
+}
+
+int TaskScheduler::workerIndex() {
+    return currentWorker;
+}
+
+void TaskScheduler::spawn(Task task) {
+    ++pending;
+    if (currentScheduler == this && currentWorker >= 0) {
+        Worker& own = *workers[currentWorker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        own.tasks.push_back(std::move(task));
+        return;
+    }
+    std::lock_guard<std::mutex> lock(queueMutex);
+    queue.push_back(std::move(task));
+}
+
+bool TaskScheduler::next(int w, Task& task) {
+    // Own tasks, newest first
+    {
+        Worker& own = *workers[w];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    // The oldest task of another worker
+    for (int k = 1; k < nThreads; ++k) {
+        Worker& victim = *workers[(w + k) % nThreads];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    // A new queued task
+    std::lock_guard<std::mutex> lock(queueMutex);
+    if (queue.empty())
+        return false;
+    task = std::move(queue.front());
+    queue.pop_front();
+    return true;
+}
+
+void TaskScheduler::work(int w) {
+    currentWorker = w;
+    currentScheduler = this;
+    Task task;
+    // A worker only stops when no task is left anywhere: a running task may still spawn more
+    while (pending > 0) {
+        if (!next(w, task)) {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            continue;
+        }
+        try {
+            task();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error)
+                error = std::current_exception();
+        }
+        task = nullptr;
+        --pending;
+    }
+    currentWorker = -1;
+    currentScheduler = nullptr;
+}
+
+void TaskScheduler::run() {
+    if (nThreads == 1) {
+        work(0);
+    } else {
+        std::vector<std::thread> threads;
+        for (int w = 0; w < nThreads; ++w)
+            threads.emplace_back([this, w]() { work(w); });
+        for (auto& t : threads)
+            t.join();
+    }
+    if (error) {
+        std::exception_ptr e = error;
+        error = nullptr;
+        std::rethrow_exception(e);
+    }
+}
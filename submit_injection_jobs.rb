@@ -20,7 +20,7 @@ parser = OptionParser.new do |opts|
   opts.on("--bins_per_job INTEGER", Integer, "Number of bins per job (required)") { |v| options[:bins_per_job] = v }
   opts.on("--grid STRING", "Grid string (required) e.g. \"X,Q\". Values must be one of: X, Q, Z, PhPerp") { |v| options[:grid] = v }
   opts.on("--maxEntries INTEGER", Integer, "Maximum entries to process from ROOT file (default: all)") { |v| options[:maxEntries] = v }
-  opts.on("--extract_with_true STRING", "Whether to extract with true kinematics (default: false)") { |v| options[:extract_with_true] = v }
+  opts.on("--extract_with_true STRING", "Whether to extract with true kinematics: true, false or both (default: false)") { |v| options[:extract_with_true] = v }
   opts.on("--tree STRING", "Tree name (default: #{options[:tree]})") { |v| options[:tree] = v }
   opts.on("-h", "--help", "Show this message") { puts opts; exit }
 end
@@ -71,8 +71,8 @@ end
 
 # Validate extract_with_true if set
 if options[:extract_with_true]
-  unless ['true', 'false'].include?(options[:extract_with_true].downcase)
-    puts "Error: --extract_with_true must be 'true' or 'false' if provided"
+  unless ['true', 'false', 'both'].include?(options[:extract_with_true].downcase)
+    puts "Error: --extract_with_true must be 'true', 'false' or 'both' if provided"
     exit 1
   end
   options[:extract_with_true] = options[:extract_with_true].downcase
@@ -177,6 +177,8 @@ end
     if options[:maxEntries] && options[:maxEntries] > 0
       f.puts "  --maxEntries #{options[:maxEntries]} \\"
     end
+    # A requeued or resubmitted job continues from the journal of the killed one
+    f.puts "  --resume \\"
     f.puts "  --outFilename #{yaml_out} \\"
     f.puts "  --outDir #{slurm_subdir}"
     f.puts ""
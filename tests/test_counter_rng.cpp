@@ -0,0 +1,54 @@
+#include "CounterRng.h"
+#include "Logger.h"
+#include <cmath>
+#include <iostream>
+
+// Philox4x32-10 known-answer vectors (Random123 kat_vectors) and stream independence checks
+int main() {
+    struct Kat {
+        Philox4x32::Counter ctr;
+        Philox4x32::Key key;
+        Philox4x32::Counter expected;
+    };
+    const Kat kats[] = {
+        {{0, 0, 0, 0}, {0, 0}, {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}},
+        {{0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}, {0xffffffff, 0xffffffff}, {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}},
+        {{0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}, {0xa4093822, 0x299f31d0}, {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}},
+    };
+    for (const auto& k : kats) {
+        if (Philox4x32::generate(k.ctr, k.key) != k.expected) {
+            LOG_ERROR("Philox4x32 output does not match the known-answer vector");
+            return 1;
+        }
+    }
+
+    // Same key and counter reproduce the draw; changing any component of the key changes it
+    const SpinStream s{42, 3, 7};
+    const auto u = s.draw(123456789012ULL);
+    if (u != s.draw(123456789012ULL) || u == SpinStream{43, 3, 7}.draw(123456789012ULL) ||
+        u == SpinStream{42, 4, 7}.draw(123456789012ULL) || u == SpinStream{42, 3, 8}.draw(123456789012ULL) ||
+        u == s.draw(123456789013ULL)) {
+        LOG_ERROR("SpinStream draws are not keyed by (seed, bin, injection, entry)");
+        return 1;
+    }
+
+    // Mean of the uniforms over many entries
+    double sum = 0.0;
+    const int n = 300000;
+    for (int i = 0; i < n; ++i) {
+        for (double x : s.draw(i)) {
+            if (!(x > 0.0 && x < 1.0)) {
+                LOG_ERROR("SpinStream uniform outside (0, 1)");
+                return 1;
+            }
+            sum += x;
+        }
+    }
+    const double mean = sum / (3.0 * n);
+    if (std::abs(mean - 0.5) > 0.002) {
+        LOG_ERROR("SpinStream uniforms are biased: mean = " + std::to_string(mean));
+        return 1;
+    }
+    std::cout << "Test passed." << std::endl;
+    return 0;
+}
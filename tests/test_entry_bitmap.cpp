@@ -0,0 +1,77 @@
+#include "EntryBitmap.h"
+#include "Logger.h"
+#include <iostream>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+// Compare EntryBitmap against std::set on sparse, dense and out-of-order inputs
+static bool sameContents(const EntryBitmap& bm, const std::set<uint64_t>& ref) {
+    std::vector<uint64_t> got;
+    bm.forEach([&](uint64_t e) { got.push_back(e); });
+    return got.size() == ref.size() && bm.cardinality() == ref.size() && std::equal(got.begin(), got.end(), ref.begin());
+}
+
+int main() {
+    std::mt19937_64 rng(42);
+    EntryBitmap sparse, dense;
+    std::set<uint64_t> refSparse, refDense;
+    for (uint64_t i = 0; i < 300000; ++i) {
+        if (rng() % 97 == 0) {
+            sparse.add(i);
+            refSparse.insert(i);
+        }
+        if (rng() % 3 == 0) {
+            dense.add(i);
+            refDense.insert(i);
+        }
+    }
+    // Out-of-order insertion
+    for (int k = 0; k < 1000; ++k) {
+        uint64_t e = rng() % 500000;
+        sparse.add(e);
+        refSparse.insert(e);
+    }
+    if (!sameContents(sparse, refSparse) || !sameContents(dense, refDense)) {
+        LOG_ERROR("EntryBitmap contents differ from reference");
+        return 1;
+    }
+    for (uint64_t probe : {0ULL, 65535ULL, 65536ULL, 123457ULL, 499999ULL}) {
+        if (sparse.contains(probe) != (refSparse.count(probe) > 0)) {
+            LOG_ERROR("EntryBitmap::contains mismatch at " + std::to_string(probe));
+            return 1;
+        }
+    }
+
+    EntryBitmap merged = EntryBitmap::unite({&sparse, &dense});
+    std::set<uint64_t> refMerged = refSparse;
+    refMerged.insert(refDense.begin(), refDense.end());
+    if (!sameContents(merged, refMerged)) {
+        LOG_ERROR("EntryBitmap union differs from reference");
+        return 1;
+    }
+
+    // Ranges inside one chunk, across chunk boundaries and past the last entry
+    for (const auto& range : {std::make_pair(100ULL, 200ULL), std::make_pair(60000ULL, 140000ULL), std::make_pair(131072ULL, 196608ULL),
+                              std::make_pair(250000ULL, 600000ULL)}) {
+        std::vector<uint64_t> got;
+        merged.forEachInRange(range.first, range.second, [&](uint64_t e) { got.push_back(e); });
+        const std::vector<uint64_t> want(refMerged.lower_bound(range.first), refMerged.lower_bound(range.second));
+        if (got != want) {
+            LOG_ERROR("EntryBitmap::forEachInRange differs from reference on [" + std::to_string(range.first) + ", " +
+                      std::to_string(range.second) + ")");
+            return 1;
+        }
+    }
+
+    EntryBitmap restored = EntryBitmap::deserialize(merged.serialize());
+    if (!sameContents(restored, refMerged)) {
+        LOG_ERROR("EntryBitmap serialization round trip failed");
+        return 1;
+    }
+    LOG_INFO("EntryBitmap: " + std::to_string(merged.cardinality()) + " entries in " +
+             std::to_string(merged.serialize().size()) + " bytes");
+    std::cout << "Test passed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,65 @@
+#include "EventRange.h"
+#include "Logger.h"
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// forEach must visit exactly the entries accepted by contains, in increasing order
+static bool consistent(const EventRange& range, Long64_t nEntries, Long64_t& visited) {
+    std::vector<Long64_t> got;
+    range.forEach(0, nEntries, [&](Long64_t e) { got.push_back(e); });
+    std::vector<Long64_t> ref;
+    for (Long64_t e = 0; e < nEntries; ++e) {
+        if (range.contains(e))
+            ref.push_back(e);
+    }
+    visited = static_cast<Long64_t>(got.size());
+    return got == ref;
+}
+
+int main() {
+    const Long64_t n = 200000;
+    Long64_t visited = 0;
+
+    EventRange firstN = EventRange::firstN(1000);
+    if (!consistent(firstN, n, visited) || visited != 1000 || firstN.count(n) != 1000.0) {
+        LOG_ERROR("EventRange::firstN visited " + std::to_string(visited) + " entries");
+        return 1;
+    }
+
+    EventRange strided;
+    strided.setFirst(17).setLast(150000).setStride(7);
+    if (!consistent(strided, n, visited) || visited != static_cast<Long64_t>(strided.count(n))) {
+        LOG_ERROR("EventRange stride mismatch");
+        return 1;
+    }
+
+    EventRange list;
+    list.setEntries({5, 3, 3, 99, 150001, 42}).setLast(150000);
+    if (!consistent(list, n, visited) || visited != 4 || list.count(n) != 4.0) {
+        LOG_ERROR("EventRange entry list mismatch");
+        return 1;
+    }
+
+    EventRange sub;
+    sub.setFraction(0.1, 12345).setStride(2);
+    if (!consistent(sub, n, visited)) {
+        LOG_ERROR("EventRange fraction mismatch");
+        return 1;
+    }
+    // Hash subsample: deterministic and close to the requested fraction (5 sigma)
+    const double expected = sub.count(n);
+    if (std::abs(visited - expected) > 5.0 * std::sqrt(expected)) {
+        LOG_ERROR("EventRange fraction kept " + std::to_string(visited) + " entries, expected " + std::to_string(expected));
+        return 1;
+    }
+    Long64_t again = 0;
+    consistent(sub, n, again);
+    if (again != visited || sub.tag().empty() || !EventRange().isFull() || !EventRange().tag().empty()) {
+        LOG_ERROR("EventRange is not deterministic");
+        return 1;
+    }
+
+    std::cout << "Test passed." << std::endl;
+    return 0;
+}
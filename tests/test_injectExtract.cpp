@@ -22,6 +22,9 @@ int main(int argc, char** argv) {
     tmd.setTargetPolarization(args.targetPolarization);
     tmd.setOutDir(args.outDir);
     tmd.setOutFilename(args.outFilename);
+    tmd.setSeed(args.seed);
+    tmd.setResumeInjections(args.resume);
+    tmd.setOverwriteInjections(args.overwrite);
     if(args.table.empty()){
         LOG_FATAL("Table not specified. Use --table </path/to/table.csv>");
     }
@@ -34,7 +37,20 @@ int main(int argc, char** argv) {
         .bin_index = args.bin_index,
         .n = args.n_injections,
         .extract_with_true = args.extract_with_true,
-        .A_opt = args.A_opt
+        .A_opt = args.A_opt,
+        .extract_both = args.extract_both,
+        .A_scan = args.A_scan,
+        .polarization_scan = args.polarization_scan,
+        .common_random_numbers = args.common_random_numbers,
+        .target_precision = args.target_precision,
+        .min_injections = args.min_injections,
+        .max_injections = args.max_injections,
+        .asimov = args.asimov,
+        .binned = args.binned,
+        .modulations = args.modulations,
+        .A_modulations = args.A_modulations,
+        .bootstrap = args.bootstrap,
+        .aggregate = args.aggregate
     });
     tmd.runQueuedInjections();
     LOG_INFO("inject_extract completed");
@@ -0,0 +1,114 @@
+#include "CounterRng.h"
+#include "Inject.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+// Heap allocations of the process, counted by the replaced global operator new
+static long long allocations = 0;
+void* operator new(size_t n) {
+    ++allocations;
+    if (void* p = std::malloc(n ? n : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+// After a warm-up injection, the injections of a prepared bin reuse the injector's buffers: the binned and the
+// aggregated fits make no heap allocation per injection, and the multi-modulation fit only allocates the amplitude
+// and correlation vectors of its result
+int main() {
+    const Bin bin(0.0, 1.0, 0.0, 100.0, 0.0, 1.0, 0.0, 10.0);
+    PreparedBin p;
+    p.bin = &bin;
+    p.fitsReco = true;
+    p.fitsTrue = true;
+    const SpinStream kin{11, 0, 0, 1};
+    for (Long64_t e = 0; e < 20000; ++e) {
+        const auto u = kin.draw(static_cast<uint64_t>(e));
+        Event ev{};
+        ev.X = ev.TrueX = 0.1;
+        ev.Q2 = ev.TrueQ2 = 10.0;
+        ev.Y = ev.TrueY = 0.05 + 0.9 * u[0];
+        ev.PhiH = ev.TruePhiH = 2 * M_PI * u[1];
+        ev.PhiS = ev.TruePhiS = 2 * M_PI * u[2];
+        ev.Weight = 1.0;
+        p.events.push_back(ev);
+        p.entries.push_back(e);
+        p.inReco.push_back(1);
+        p.inTrue.push_back(1);
+    }
+    for (KinematicsBatch* batch : {&p.truth, &p.reco}) {
+        batch->reserve(p.size());
+        for (const Event& ev : p.events)
+            batch->push(ev.TrueX, ev.TrueQ2, ev.TrueY, ev.TruePhiH, ev.TruePhiS);
+        batch->compute();
+    }
+
+    Inject injector(nullptr, nullptr, 1.0, 1.0);
+    injector.setRandomStream(11, 0);
+    const Inject::Point point{0.3, 0.8, {}};
+    auto perInjection = [&](const Inject::Point& at) {
+        injector.injectExtract(p, at, 0);
+        const long long before = allocations;
+        for (int i = 1; i <= 20; ++i)
+            injector.injectExtract(p, at, i);
+        return allocations - before;
+    };
+
+    // Binned fit: every event in the cell of its analyzing power
+    p.nCells = 20;
+    for (const KinematicsBatch* batch : {&p.reco, &p.truth}) {
+        std::vector<int>& cells = batch == &p.reco ? p.recoCell : p.trueCell;
+        std::vector<double>& cellG = batch == &p.reco ? p.recoCellG : p.trueCellG;
+        std::vector<double> count(p.nCells, 0.0);
+        cellG.assign(p.nCells, 0.0);
+        for (size_t k = 0; k < p.size(); ++k) {
+            const double g = batch->S_T[k] * batch->Depol[k] * batch->SinPhi[k];
+            cells.push_back(std::clamp(static_cast<int>((g + 1.0) * 0.5 * p.nCells), 0, p.nCells - 1));
+            cellG[cells.back()] += g;
+            count[cells.back()] += 1.0;
+        }
+        for (int j = 0; j < p.nCells; ++j)
+            cellG[j] = count[j] > 0 ? cellG[j] / count[j] : 0.0;
+    }
+    const long long binned = perInjection(point);
+
+    p.nCells = 0;
+    injector.setAggregation(1e-3);
+    const long long aggregated = perInjection(point);
+
+    // Multi-modulation fit: the basis and its moments over both datasets, as Inject::prepare computes them
+    p.modulations = {Modulation{Modulation::Kind::Collins}, Modulation{Modulation::Kind::Sivers}};
+    const size_t K = p.modulations.size();
+    for (const KinematicsBatch* batch : {&p.reco, &p.truth}) {
+        std::vector<double>& basis = batch == &p.reco ? p.recoBasis : p.trueBasis;
+        ModulationMoments& moments = batch == &p.reco ? p.recoMoments : p.trueMoments;
+        basis.assign(p.size() * K, 0.0);
+        moments.reset(static_cast<int>(K));
+        for (size_t k = 0; k < p.size(); ++k) {
+            for (size_t m = 0; m < K; ++m) {
+                const double d = p.modulations[m].usesDepolarization() ? batch->Depol[k] : 1.0;
+                basis[k * K + m] = batch->S_T[k] * d * p.modulations[m].f(batch->PhiH[k], batch->PhiS[k]);
+            }
+            moments.add(&basis[k * K], 1.0);
+        }
+    }
+    const Inject::Point modulated{0.3, 0.8, {0.3, -0.1}};
+    // Amplitudes and correlations of the reco and true datasets: four result vectors per injection
+    const long long modulations = perInjection(modulated);
+
+    if (binned != 0 || aggregated != 0 || modulations > 4 * 20) {
+        LOG_ERROR("Heap allocations in 20 injections: binned " + std::to_string(binned) + ", aggregated " + std::to_string(aggregated) +
+                  ", modulations " + std::to_string(modulations) + " (at most 80 for the results)");
+        return 1;
+    }
+    std::cout << "Test passed." << std::endl;
+    return 0;
+}
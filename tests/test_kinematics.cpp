@@ -0,0 +1,51 @@
+#include "Kinematics.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+// Every vector kernel available on this CPU must agree with the scalar reference to 1e-12
+static double maxDiff(const std::vector<double>& a, const std::vector<double>& b) {
+    double d = 0.0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (std::isnan(a[i]) || std::isnan(b[i])) {
+            if (std::isnan(a[i]) != std::isnan(b[i]))
+                return INFINITY;
+            continue;
+        }
+        d = std::max(d, std::abs(a[i] - b[i]));
+    }
+    return d;
+}
+
+int main() {
+    std::mt19937_64 rng(7);
+    std::uniform_real_distribution<double> u(0.0, 1.0);
+    KinematicsBatch batch;
+    const double pi = std::acos(-1.0);
+    for (int i = 0; i < 10003; ++i)
+        batch.push(u(rng), 1.0 + 100.0 * u(rng), u(rng), 2 * pi * (2 * u(rng) - 1), 2 * pi * (2 * u(rng) - 1));
+    // Edge cases: non-positive Q2, large gamma, Y outside [0, 1], NaN input
+    batch.push(0.5, 0.0, 0.5, 1.0, 1.0);
+    batch.push(0.9, 1e-4, 0.9, -6.0, 6.0);
+    batch.push(0.1, 2.0, 1.5, 0.0, -0.0);
+    batch.push(0.1, -1.0, -0.2, pi, -pi);
+    batch.push(NAN, 2.0, 0.3, 0.1, 0.2);
+
+    batch.compute(KinematicsBatch::Isa::Scalar);
+    const auto gamma = batch.Gamma, st = batch.S_T, depol = batch.Depol, sinPhi = batch.SinPhi;
+    for (auto isa : {KinematicsBatch::Isa::AVX2, KinematicsBatch::Isa::AVX512}) {
+        batch.compute(isa);
+        const double d = std::max({maxDiff(gamma, batch.Gamma), maxDiff(st, batch.S_T), maxDiff(depol, batch.Depol),
+                                   maxDiff(sinPhi, batch.SinPhi)});
+        LOG_INFO(std::string("Kinematics ") + KinematicsBatch::isaName(isa) + " (CPU best: " +
+                 KinematicsBatch::isaName(KinematicsBatch::bestIsa()) + ") max |diff| = " + std::to_string(d * 1e12) + "e-12");
+        if (!(d <= 1e-12)) {
+            LOG_ERROR("Vector kinematics differ from the scalar reference");
+            return 1;
+        }
+    }
+    std::cout << "Test passed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include "CounterRng.h"
+#include "Logger.h"
+#include "Modulation.h"
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// Sivers, Collins and pretzelosity amplitudes injected together are recovered by the moment solution,
+// and the spread of the toys matches its covariance
+int main() {
+    const std::vector<Modulation> mods = {*Modulation::parse("collins"), *Modulation::parse("Sivers"), *Modulation::parse("pretzelosity")};
+    if (Modulation::parse("boer-mulders")) {
+        LOG_ERROR("Unknown modulation was accepted");
+        return 1;
+    }
+    const int K = static_cast<int>(mods.size());
+    const double injected[] = {0.3, -0.1, 0.05};
+    const double polarization = 0.7;
+    const size_t nEvents = 20000;
+    const int nToys = 200;
+
+    // Event basis b_m = S_T D_m f_m and its unit-weight moments, computed once
+    const SpinStream kin{7, 0, 0, 1};
+    std::vector<double> basis(nEvents * K);
+    ModulationMoments moments;
+    moments.reset(K);
+    for (size_t e = 0; e < nEvents; ++e) {
+        const auto u = kin.draw(e);
+        const double phiH = 2 * M_PI * u[0], phiS = 2 * M_PI * u[1], y = 0.05 + 0.9 * u[2];
+        const double depol = (1 - y) / (1 - y + 0.5 * y * y);
+        for (int m = 0; m < K; ++m)
+            basis[e * K + m] = (mods[m].usesDepolarization() ? depol : 1.0) * mods[m].f(phiH, phiS);
+        moments.add(&basis[e * K], 1.0);
+    }
+
+    std::vector<double> sum(K, 0.0), sum2(K, 0.0), meanError(K, 0.0);
+    for (int t = 0; t < nToys; ++t) {
+        const SpinStream spins{7, 0, static_cast<uint32_t>(t), 0};
+        std::vector<double> v(K, 0.0);
+        for (size_t e = 0; e < nEvents; ++e) {
+            double a = 0.0;
+            for (int m = 0; m < K; ++m)
+                a += injected[m] * basis[e * K + m];
+            const int spin = spins.draw(e)[0] < 0.5 * (1 + polarization * a) ? 1 : -1;
+            for (int m = 0; m < K; ++m)
+                v[m] += spin * basis[e * K + m];
+        }
+        std::vector<double> A, cov;
+        if (!solveModulations(moments, v, polarization, A, cov)) {
+            LOG_ERROR("Moment matrix unexpectedly singular");
+            return 1;
+        }
+        for (int m = 0; m < K; ++m) {
+            sum[m] += A[m];
+            sum2[m] += A[m] * A[m];
+            meanError[m] += std::sqrt(cov[m * K + m]) / nToys;
+        }
+    }
+    for (int m = 0; m < K; ++m) {
+        const double mean = sum[m] / nToys;
+        const double stddev = std::sqrt(std::max(0.0, sum2[m] / nToys - mean * mean));
+        std::cout << mods[m].name() << ": injected " << injected[m] << ", mean " << mean << ", stddev " << stddev << ", mean error "
+                  << meanError[m] << std::endl;
+        if (std::abs(mean - injected[m]) > 5 * stddev / std::sqrt(nToys) || std::abs(stddev / meanError[m] - 1) > 0.25) {
+            LOG_ERROR(std::string("Moment solution is biased or its error is off for ") + mods[m].name());
+            return 1;
+        }
+    }
+
+    // Degenerate basis (the same modulation twice) is reported as singular
+    ModulationMoments degenerate;
+    degenerate.reset(2);
+    for (size_t e = 0; e < 100; ++e) {
+        const double b[2] = {basis[e * K], basis[e * K]};
+        degenerate.add(b, 1.0);
+    }
+    std::vector<double> A, cov;
+    if (solveModulations(degenerate, {1.0, 1.0}, 1.0, A, cov)) {
+        LOG_ERROR("Degenerate moment matrix was not detected");
+        return 1;
+    }
+
+    std::cout << "Test passed." << std::endl;
+    return 0;
+}
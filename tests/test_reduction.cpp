@@ -0,0 +1,91 @@
+#include "CounterRng.h"
+#include "Logger.h"
+#include "Reduction.h"
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+// Compensated and pairwise sums keep the small addends a naive sum drops, and per-file compensated partial sums merged
+// in file order stay exact on ill-conditioned input. The thread-count independence of the engines is checked by
+// `make run-tests`, which compares project_errors outputs on 1 and 4 threads.
+int main() {
+    // One large weight followed by many below its half ulp: the naive sum never moves
+    const double big = 1e8, small = 1e-9;
+    const int nSmall = 10000000;
+    CompensatedSum compensated;
+    double naive = big;
+    compensated += big;
+    for (int i = 0; i < nSmall; ++i) {
+        compensated += small;
+        naive += small;
+    }
+    const double exact = big + nSmall * small;
+    if (std::abs(compensated.value() - exact) > 1e-8 || naive != big) {
+        LOG_ERROR("Compensated sum " + std::to_string(compensated.value()) + " differs from " + std::to_string(exact));
+        return 1;
+    }
+
+    // Pairwise sum of weights spanning six orders of magnitude, against a compensated reference
+    const SpinStream s{5, 0, 0, 0};
+    std::vector<double> w(1 << 20);
+    for (size_t i = 0; i < w.size(); ++i)
+        w[i] = std::pow(10.0, 6 * s.draw(i)[0] - 3);
+    CompensatedSum reference;
+    double naiveW = 0.0;
+    for (double x : w) {
+        reference += x;
+        naiveW += x;
+    }
+    const double pairwise = pairwiseSum(0, w.size(), [&](size_t i) { return w[i]; });
+    const double pairwiseError = std::abs(pairwise - reference.value()), naiveError = std::abs(naiveW - reference.value());
+    if (pairwiseError > 1e-13 * reference.value() || pairwiseError > naiveError) {
+        LOG_ERROR("Pairwise sum error " + std::to_string(pairwiseError) + " (naive " + std::to_string(naiveError) + ")");
+        return 1;
+    }
+
+    // Ill-conditioned sum: large weights that cancel in pairs, interleaved with small ones. Every term is a multiple of
+    // 2^-20 below 2^41, so the exact total is an integer count of 2^-20 units.
+    const double unit = std::ldexp(1.0, -20);
+    std::vector<double> terms;
+    long long exactUnits = 0;
+    for (uint64_t i = 0; i < 100000; ++i) {
+        const auto u = s.draw(i);
+        const double large = std::ldexp(std::floor(u[0] * 1048576.0) + 1.0, 20);
+        const long long smallUnits = static_cast<long long>(u[1] * 1048576.0);
+        terms.push_back(large);
+        terms.push_back(smallUnits * unit);
+        terms.push_back(-large);
+        exactUnits += smallUnits;
+    }
+    // Shuffle, so the cancelling pairs are far apart and straddle the file boundaries below
+    for (size_t i = terms.size() - 1; i > 0; --i)
+        std::swap(terms[i], terms[static_cast<size_t>(s.draw(1000000 + i)[2] * (i + 1))]);
+    const double exactTotal = exactUnits * unit;
+    CompensatedSum all;
+    double naiveTotal = 0.0;
+    for (double x : terms) {
+        all += x;
+        naiveTotal += x;
+    }
+    // Per-file partial sums merged in file order, as the engines do
+    const std::vector<size_t> fileSizes = {100000, 3, 50000, 77777, 1, 40000, 32219};
+    CompensatedSum merged;
+    for (size_t f = 0, first = 0; f < fileSizes.size(); first += fileSizes[f++]) {
+        CompensatedSum part;
+        for (size_t i = first; i < first + fileSizes[f]; ++i)
+            part += terms[i];
+        merged.merge(part);
+    }
+    const double tolerance = 1e-12 * exactTotal;
+    if (std::abs(all.value() - exactTotal) > tolerance || std::abs(merged.value() - exactTotal) > tolerance ||
+        std::abs(naiveTotal - exactTotal) < 1e3 * tolerance) {
+        LOG_ERROR("Ill-conditioned sum: compensated " + std::to_string(all.value()) + ", merged " + std::to_string(merged.value()) +
+                  ", naive " + std::to_string(naiveTotal) + ", exact " + std::to_string(exactTotal));
+        return 1;
+    }
+
+    std::cout << "Test passed." << std::endl;
+    return 0;
+}
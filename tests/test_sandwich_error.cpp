@@ -0,0 +1,54 @@
+#include "ArgParser.h"
+#include "Inject.h"
+#include "Logger.h"
+#include "TMD.h"
+#include <cmath>
+#include <iostream>
+
+// Regression of the closed-form (sandwich) fit errors against RooFit's SumW2Error errors on the same toys
+// of a generate_pseudodata bin, for reco- and true-binned fits, toy and Asimov datasets
+int main(int argc, char** argv) {
+    Args args = parseArgs(argc, argv);
+
+    TMD tmd(args.filename, args.treename);
+    if (!tmd.isLoaded()) {
+        LOG_ERROR("TMD failed to load generated tree file");
+        return 1;
+    }
+    if (args.table.empty()) {
+        LOG_FATAL("Table not specified. Use --table </path/to/table.csv>");
+    }
+    tmd.loadTable(args.table, args.energyConfig);
+    tmd.buildGrid({"X"});
+    const Bin bin = tmd.getGrid()->getBinByIndex(args.bin_index);
+
+    Inject injector(tmd.getSource(), tmd.getTable(), tmd.scale, args.targetPolarization);
+    injector.setRandomStream(args.seed, static_cast<uint32_t>(args.bin_index));
+    const PreparedBin prep = injector.prepare(bin, true, true, false);
+    const Inject::Point point{args.A_opt.value_or(0.3), args.targetPolarization, {}};
+
+    auto compare = [](const char* what, double closed, double roofit, double tolerance) {
+        const double rel = roofit != 0.0 ? std::abs(closed / roofit - 1) : std::abs(closed);
+        std::cout << what << ": closed form " << closed << ", RooFit " << roofit << " (relative difference " << rel << ")" << std::endl;
+        return rel < tolerance;
+    };
+    bool ok = true;
+    for (int i = 0; i < std::max(1, args.n_injections); ++i) {
+        injector.setRooFitErrors(false);
+        const Inject::DualResult closed = i == 0 ? injector.injectExtractAsimov(prep, point) : injector.injectExtract(prep, point, i);
+        injector.setRooFitErrors(true);
+        const Inject::DualResult roofit = i == 0 ? injector.injectExtractAsimov(prep, point) : injector.injectExtract(prep, point, i);
+        // Same minimization, so the values agree to the MIGRAD tolerance; HESSE is numerical, hence the looser error check
+        ok &= std::abs(closed.reco.first - roofit.reco.first) < 1e-4 && std::abs(closed.truth.first - roofit.truth.first) < 1e-4;
+        ok &= compare("reco raw error", closed.recoRawError, roofit.recoRawError, 1e-2);
+        ok &= compare("reco scaled error", closed.reco.second, roofit.reco.second, 1e-2);
+        ok &= compare("true raw error", closed.trueRawError, roofit.trueRawError, 1e-2);
+        ok &= compare("true scaled error", closed.truth.second, roofit.truth.second, 1e-2);
+    }
+    if (!ok) {
+        LOG_ERROR("Closed-form errors do not reproduce the RooFit SumW2Error errors");
+        return 1;
+    }
+    std::cout << "Test passed." << std::endl;
+    return 0;
+}
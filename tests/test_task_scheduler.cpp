@@ -0,0 +1,80 @@
+#include "Logger.h"
+#include "TaskScheduler.h"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Bins of very uneven cost spawn one task per injection: every injection runs exactly once, the injections of the
+// largest bin are stolen by idle workers, and a task exception reaches the caller
+int main() {
+    const int nThreads = 4;
+    const std::vector<int> injections = {200, 1, 3, 1, 2, 1, 1, 5, 1, 1};
+    std::vector<std::vector<int>> runs(injections.size());
+    std::vector<std::set<int>> workersOf(injections.size());
+    std::mutex workersMutex;
+    std::atomic<int> binsDone{0};
+
+    TaskScheduler scheduler(nThreads);
+    for (size_t b = 0; b < injections.size(); ++b) {
+        runs[b].assign(injections[b], 0);
+        scheduler.spawn([&, b]() {
+            auto remaining = std::make_shared<std::atomic<int>>(injections[b]);
+            for (int i = 0; i < injections[b]; ++i) {
+                scheduler.spawn([&, b, i, remaining]() {
+                    std::this_thread::sleep_for(std::chrono::microseconds(500));
+                    ++runs[b][i];
+                    {
+                        std::lock_guard<std::mutex> lock(workersMutex);
+                        workersOf[b].insert(TaskScheduler::workerIndex());
+                    }
+                    if (--*remaining == 0)
+                        ++binsDone;
+                });
+            }
+        });
+    }
+    scheduler.run();
+
+    for (size_t b = 0; b < injections.size(); ++b) {
+        for (int i = 0; i < injections[b]; ++i) {
+            if (runs[b][i] != 1) {
+                LOG_ERROR("Injection " + std::to_string(i) + " of bin " + std::to_string(b) + " ran " + std::to_string(runs[b][i]) +
+                          " times");
+                return 1;
+            }
+        }
+    }
+    if (binsDone != static_cast<int>(injections.size()) || workersOf[0].size() < 2) {
+        LOG_ERROR("Bins done: " + std::to_string(binsDone) + ", workers on the largest bin: " + std::to_string(workersOf[0].size()));
+        return 1;
+    }
+
+    // The first exception thrown by a task is rethrown by run(), after the other tasks finished
+    std::atomic<int> ran{0};
+    for (int t = 0; t < 20; ++t) {
+        scheduler.spawn([&, t]() {
+            ++ran;
+            if (t == 7)
+                throw std::runtime_error("task failed");
+        });
+    }
+    bool thrown = false;
+    try {
+        scheduler.run();
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    if (!thrown || ran != 20) {
+        LOG_ERROR("Exception not propagated or tasks skipped (" + std::to_string(ran) + " of 20 ran)");
+        return 1;
+    }
+    std::cout << "Test passed." << std::endl;
+    return 0;
+}